@@ -0,0 +1,37 @@
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+#include "src/decode_service_712.h"
+
+static DecodeService712 service;
+
+static void HandleSignal(int)
+{
+    service.Stop();
+}
+
+// Usage: viterbi_decoder_712d <socket path> [workers] [batch bits]
+int main(int argc, char *argv[])
+{
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s <socket path> [workers] [batch bits]\n", argv[0]);
+        return 1;
+    }
+    if(argc > 2) {
+        service.SetWorkers(atoi(argv[2]));
+    }
+    if(argc > 3) {
+        service.SetBatchBits(atoi(argv[3]));
+    }
+
+    signal(SIGINT, HandleSignal);
+    signal(SIGTERM, HandleSignal);
+
+    if(!service.Run(argv[1])) {
+        fprintf(stderr, "unable to listen on %s\n", argv[1]);
+        return 1;
+    }
+
+    return 0;
+}
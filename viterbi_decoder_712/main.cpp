@@ -1,10 +1,557 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <vector>
 
+#include "src/bitsliced_viterbi_decoder_712.h"
+#include "src/concatenated_decoder_712.h"
+#include "src/reed_solomon_255_223.h"
+#include "src/viterbi_channel_bank_712.h"
 #include "src/viterbi_decoder_712.h"
 
-int main()
+// Compares throughput and BER of reduced state decoding against full Viterbi
+// for each shipped puncture pattern. Run with the 'benchmark' argument.
+// Reduced state decoding runs on the register exchange engine, which limits
+// the traceback depth to 62.
+static void ReducedStateBenchmark()
 {
+    const BitVector patterns[4] = { PuncturePattern712_12, PuncturePattern712_23,
+                                    PuncturePattern712_34, PuncturePattern712_56 };
+    const uint32_t depths[4] = { Traceback712_12, Traceback712_23, Traceback712_34, Traceback712_56 };
+    const char *names[4] = { "1/2", "2/3", "3/4", "5/6" };
+    // Channel BER giving a decoded BER around 1e-4..1e-3 with full decoding
+    const double channelBer[4] = { 0.03, 0.012, 0.006, 0.003 };
+
+    // Full decoding with each engine, then kept states M and threshold pairs.
+    // Speedup is against the first, the default decoder.
+    struct Mode {
+        bool exchange;
+        uint32_t states, threshold;
+    };
+    const Mode modes[7] = { { false, 64, 0 }, { true, 64, 0 }, { true, 32, 0 }, { true, 16, 0 },
+                            { true, 64, 3 }, { true, 64, 4 }, { true, 16, 3 } };
+
+    // Multiple of every pattern period
+    const int inputBits = 300000;
+    std::mt19937 rng(712);
+
+    printf("rate  engine    M  thr  depth  Mbit/s  speedup  BER\n");
+    for(int p = 0; p < 4; p++) {
+        BitVector input;
+        for(int i = 0; i < inputBits; i++) {
+            input.PushBack(rng() & 0x1);
+        }
+
+        ConvolutionalEncoder712 encoder;
+        encoder.SetPuncturePattern(patterns[p]);
+        BitVector encoded = encoder.Encode(input);
+
+        std::bernoulli_distribution flip(channelBer[p]);
+        for(int i = 0; i < encoded.Length(); i++) {
+            if(flip(rng)) {
+                encoded.FlipBit(i);
+            }
+        }
+
+        double fullRate = 0.0;
+        for(int m = 0; m < 7; m++) {
+            const Mode &mode = modes[m];
+            const int depth = mode.exchange ? std::min<uint32_t>(depths[p], 62) : depths[p];
+            ViterbiDecoder712H decoder;
+            decoder.SetPuncturePattern(patterns[p]);
+            if(mode.exchange) {
+                decoder.SetSurvivorEngine(SurvivorEngine712::RegisterExchange);
+            }
+            decoder.SetTracebackDepth(depth);
+            decoder.SetReducedState(mode.states, mode.threshold);
+
+            // Best of a few runs
+            BitVector decoded;
+            double seconds = 0.0;
+            for(int run = 0; run < 3; run++) {
+                decoder.Reset();
+                auto start = std::chrono::steady_clock::now();
+                decoded = decoder.Decode(encoded);
+                double runSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                seconds = (run == 0) ? runSeconds : std::min(seconds, runSeconds);
+            }
+
+            // Continuous output is delayed by the traceback depth
+            int compared = inputBits - depth;
+            int errors = HammingDistance(decoded.Extract(depth, compared), input.Extract(0, compared));
+
+            double rate = inputBits / seconds / 1e6;
+            if(m == 0) {
+                fullRate = rate;
+            }
+
+            printf("%s   %s  %2u  %3u  %5d  %6.2f  %6.2fx  %.2e\n", names[p],
+                   mode.exchange ? "exchange " : "traceback", mode.states, mode.threshold, depth,
+                   rate, rate / fullRate, (double)errors / compared);
+        }
+    }
+}
+
+// Reduced state decoding keeps exactly min(states within threshold, M) states
+//   each stage (asserted inside the decoder), and keeping every state is full decoding.
+static void ReducedStateCheck()
+{
+    std::mt19937 rng(33);
+    BitVector input;
+    for(int i = 0; i < 6000; i++) {
+        input.PushBack(rng() & 0x1);
+    }
+
+    ConvolutionalEncoder712 encoder;
+    BitVector encoded = encoder.Encode(input);
+    for(int i = 0; i < encoded.Length(); i++) {
+        if(rng() % 33 == 0) {
+            encoded.FlipBit(i);
+        }
+    }
+
+    ViterbiDecoder712H full;
+    full.SetSurvivorEngine(SurvivorEngine712::RegisterExchange);
+    BitVector expected = full.Decode(encoded);
+
+    const uint32_t states[3] = { 8, 16, 64 };
+    for(uint32_t m : states) {
+        for(uint32_t threshold = 0; threshold <= 16; threshold += 2) {
+            ViterbiDecoder712H decoder;
+            decoder.SetSurvivorEngine(SurvivorEngine712::RegisterExchange);
+            decoder.SetReducedState(m, threshold);
+            BitVector decoded = decoder.Decode(encoded);
+            assert(decoded.Length() == expected.Length());
+            if(m == 64 && (threshold == 0 || threshold > 15)) {
+                assert(decoded == expected);
+            }
+        }
+    }
+}
+
+static const BitVector CheckPatterns[4] = { PuncturePattern712_12, PuncturePattern712_23,
+                                            PuncturePattern712_34, PuncturePattern712_56 };
+static const uint32_t CheckDepths[4] = { Traceback712_12, Traceback712_23,
+                                         Traceback712_34, Traceback712_56 };
+
+// Encodes 'bits' random bits (a multiple of every pattern period, 30) continuing
+//   the encoder's stream, then flips about one channel bit in flipOneIn.
+static BitVector NoisyInput(ConvolutionalEncoder712 &encoder, int bits, int flipOneIn, std::mt19937 &rng)
+{
+    BitVector input;
+    for(int i = 0; i < bits; i++) {
+        input.PushBack(rng() & 0x1);
+    }
+    BitVector encoded = encoder.Encode(input);
+    for(int i = 0; i < encoded.Length(); i++) {
+        if(rng() % flipOneIn == 0) {
+            encoded.FlipBit(i);
+        }
+    }
+    return encoded;
+}
+
+// Radix 4 decodes clean and sparsely corrupted input back to the known input,
+//   terminated and continuous, for every shipped pattern.
+static void Radix4Check()
+{
+    std::mt19937 rng(26);
+
+    for(int p = 0; p < 4; p++) {
+        for(int flipEvery : { 0, 97 }) {
+            // Multiple of every pattern period, ending on the zero state
+            BitVector input;
+            for(int i = 0; i < 594; i++) {
+                input.PushBack(rng() & 0x1);
+            }
+            for(int i = 0; i < 6; i++) {
+                input.PushBack(0);
+            }
+
+            ConvolutionalEncoder712 encoder;
+            encoder.SetPuncturePattern(CheckPatterns[p]);
+            BitVector encoded = encoder.Encode(input);
+            for(int i = flipEvery - 1; flipEvery > 0 && i < encoded.Length(); i += flipEvery) {
+                encoded.FlipBit(i);
+            }
+
+            ViterbiDecoder712H decoder;
+            decoder.SetRadix(4);
+            decoder.SetPuncturePattern(CheckPatterns[p]);
+            decoder.SetTracebackDepth(CheckDepths[p]);
+            assert(decoder.DecodeTerminated(encoded) == input);
+
+            // Continuous output starts with TracebackDepth zeros
+            const int depth = CheckDepths[p];
+            const int compared = input.Length() - depth;
+            BitVector decoded = decoder.Decode(encoded);
+            assert(decoded.Length() == input.Length());
+            assert(decoded.Extract(0, depth) == BitVector(depth));
+            assert(decoded.Extract(depth, compared) == input.Extract(0, compared));
+        }
+    }
+}
+
+// Flush and DecodeWithLatency return bits early without disturbing the stream,
+//   decoding continues and the output is still the input after TracebackDepth zeros.
+static void FlushLatencyCheck()
+{
+    std::mt19937 rng(29);
+
+    for(uint32_t radix = 2; radix <= 4; radix += 2) {
+        for(int p = 0; p < 4; p++) {
+            ConvolutionalEncoder712 encoder;
+            encoder.SetPuncturePattern(CheckPatterns[p]);
+
+            ViterbiDecoder712H decoder;
+            decoder.SetRadix(radix);
+            decoder.SetPuncturePattern(CheckPatterns[p]);
+            decoder.SetTracebackDepth(CheckDepths[p]);
+
+            BitVector input, decoded;
+            for(int call = 0; call < 30; call++) {
+                BitVector bits;
+                for(int i = 30 * (1 + rng() % 4); i > 0; i--) {
+                    bits.PushBack(rng() & 0x1);
+                }
+                input += bits;
+                BitVector encoded = encoder.Encode(bits);
+
+                switch(rng() % 3) {
+                case 0:
+                    decoded += decoder.Decode(encoded);
+                    break;
+                case 1:
+                    decoded += decoder.DecodeWithLatency(encoded, rng() % (CheckDepths[p] + 1));
+                    break;
+                default:
+                    decoded += decoder.Decode(encoded);
+                    decoded += decoder.Flush();
+                    break;
+                }
+            }
+            decoded += decoder.Flush();
+
+            assert(decoded == BitVector(CheckDepths[p]) + input);
+        }
+    }
+}
+
+// An encoder and a decoder sharing a schedule of pattern and traceback depth
+//   switches stay in step, the output is the input after the initial depth zeros.
+static void ScheduleCheck()
+{
+    std::mt19937 rng(31);
+    // Pattern and depth (0 keeps the depth) switched to every 60 stages
+    const int order[5] = { 2, 1, 3, 0, 2 };
+    const uint32_t depths[5] = { Traceback712_34, 0, Traceback712_56, Traceback712_12, 0 };
+
+    for(uint32_t radix = 2; radix <= 4; radix += 2) {
+        ConvolutionalEncoder712 encoder;
+        ViterbiDecoder712H decoder;
+        decoder.SetRadix(radix);
+        decoder.SetTracebackDepth(Traceback712_12);
+        for(int k = 0; k < 5; k++) {
+            encoder.SchedulePuncturePattern(CheckPatterns[order[k]], 60 * (k + 1));
+            decoder.SchedulePuncturePattern(CheckPatterns[order[k]], depths[k], 60 * (k + 1));
+        }
+
+        // Chunks of 30 stages end on a period boundary of every pattern
+        BitVector input, decoded;
+        for(int chunk = 0; chunk < 12; chunk++) {
+            BitVector bits;
+            for(int i = 0; i < 30; i++) {
+                bits.PushBack(rng() & 0x1);
+            }
+            input += bits;
+            decoded += decoder.Decode(encoder.Encode(bits));
+        }
+        decoded += decoder.Flush();
+
+        assert(decoded == BitVector(Traceback712_12) + input);
+        assert(decoder.GetPuncturePattern() == CheckPatterns[2]);
+        assert(decoder.GetTracebackDepth() == Traceback712_12);
+    }
+}
+
+// The register exchange engine returns the same bits as traceback, on noisy
+//   input with either radix and across Flush and reduced latency calls.
+static void SurvivorEngineCheck()
+{
+    std::mt19937 rng(32);
+
+    for(uint32_t radix = 2; radix <= 4; radix += 2) {
+        for(int p = 0; p < 4; p++) {
+            ConvolutionalEncoder712 encoder;
+            encoder.SetPuncturePattern(CheckPatterns[p]);
+
+            // Register exchange holds at most 62 stages
+            ViterbiDecoder712H traceback, exchange;
+            exchange.SetSurvivorEngine(SurvivorEngine712::RegisterExchange);
+            for(ViterbiDecoder712H *decoder : { &traceback, &exchange }) {
+                decoder->SetRadix(radix);
+                decoder->SetPuncturePattern(CheckPatterns[p]);
+                decoder->SetTracebackDepth(std::min<uint32_t>(CheckDepths[p], 62));
+            }
+
+            for(int call = 0; call < 20; call++) {
+                BitVector encoded = NoisyInput(encoder, 30 * (1 + rng() % 10), 25, rng);
+                switch(rng() % 3) {
+                case 0:
+                    assert(traceback.Decode(encoded) == exchange.Decode(encoded));
+                    break;
+                case 1: {
+                    uint32_t latency = rng() % 63;
+                    assert(traceback.DecodeWithLatency(encoded, latency) ==
+                           exchange.DecodeWithLatency(encoded, latency));
+                    break;
+                }
+                default:
+                    assert(traceback.Decode(encoded) == exchange.Decode(encoded));
+                    assert(traceback.Flush() == exchange.Flush());
+                    break;
+                }
+            }
+            encoder.Reset();
+            BitVector frame = NoisyInput(encoder, 600, 25, rng);
+            assert(traceback.DecodeTerminated(frame) == exchange.DecodeTerminated(frame));
+        }
+    }
+}
+
+// Noisy concatenated frames decode to the sent data. The channel leaves symbol
+//   errors after the inner decoder that the outer code corrects.
+static void ConcatenatedCheck()
+{
+    std::mt19937 rng(36);
+    // Channel BER per pattern, well inside what RS(255,223) corrects
+    const double channelBer[4] = { 0.03, 0.015, 0.009, 0.005 };
+
+    for(int p = 0; p < 4; p++) {
+        std::bernoulli_distribution flip(channelBer[p]);
+        int corrected = 0;
+
+        for(int interleave : { 1, 4 }) {
+            ConcatenatedEncoder712 encoder;
+            encoder.SetInterleave(interleave);
+            encoder.SetPuncturePattern(CheckPatterns[p]);
+
+            ConcatenatedDecoder712 decoder;
+            decoder.SetInterleave(interleave);
+            decoder.SetPuncturePattern(CheckPatterns[p]);
+            decoder.SetTracebackDepth(CheckDepths[p]);
+
+            ConcatenatedFrame712 frame;
+            for(int f = 0; f < 3; f++) {
+                std::vector<uint8_t> data(223 * interleave);
+                for(uint8_t &byte : data) {
+                    byte = rng();
+                }
+
+                BitVector encoded = encoder.Encode(data);
+                for(int i = 0; i < encoded.Length(); i++) {
+                    if(flip(rng)) {
+                        encoded.FlipBit(i);
+                    }
+                }
+
+                decoder.Decode(encoded, frame);
+                assert(frame.data == data);
+                assert((int)frame.corrected.size() == interleave);
+                for(int symbols : frame.corrected) {
+                    assert(symbols >= 0);
+                    corrected += symbols;
+                }
+            }
+        }
+        assert(corrected > 0);
+    }
+}
+
+// Bitsliced output matches ViterbiDecoder712H::Decode bit for bit on every
+//   channel, across calls and on noisy input.
+static void BitslicedCheck()
+{
+    std::mt19937 rng(37);
+    const int channels = BitslicedViterbiDecoder712H::CHANNELS;
+
+    for(int p = 0; p < 4; p++) {
+        BitslicedViterbiDecoder712H bitsliced;
+        bitsliced.SetPuncturePattern(CheckPatterns[p]);
+        bitsliced.SetTracebackDepth(CheckDepths[p]);
+
+        std::vector<ViterbiDecoder712H> decoders(channels);
+        std::vector<ConvolutionalEncoder712> encoders(channels);
+        for(int c = 0; c < channels; c++) {
+            decoders[c].SetPuncturePattern(CheckPatterns[p]);
+            decoders[c].SetTracebackDepth(CheckDepths[p]);
+            encoders[c].SetPuncturePattern(CheckPatterns[p]);
+        }
+
+        for(int call = 0; call < 3; call++) {
+            int bits = 30 * (1 + rng() % 20);
+            std::vector<BitVector> inputs(channels);
+            for(int c = 0; c < channels; c++) {
+                inputs[c] = NoisyInput(encoders[c], bits, 20 + c, rng);
+            }
+
+            std::vector<BitVector> decoded = bitsliced.Decode(inputs);
+            for(int c = 0; c < channels; c++) {
+                assert(decoded[c] == decoders[c].Decode(inputs[c]));
+            }
+        }
+    }
+}
+
+// A stream split at arbitrary points, partial puncture periods included, decodes
+//   the same as one Decode of the whole stream, with either radix.
+static void StreamSplitCheck()
+{
+    std::mt19937 rng(34);
+
+    for(int p = 0; p < 4; p++) {
+        for(uint32_t radix = 2; radix <= 4; radix += 2) {
+            ConvolutionalEncoder712 encoder;
+            encoder.SetPuncturePattern(CheckPatterns[p]);
+            BitVector encoded = NoisyInput(encoder, 30 * 100, 30, rng);
+
+            ViterbiDecoder712H whole, split;
+            for(ViterbiDecoder712H *decoder : { &whole, &split }) {
+                decoder->SetRadix(radix);
+                decoder->SetPuncturePattern(CheckPatterns[p]);
+                decoder->SetTracebackDepth(CheckDepths[p]);
+            }
+
+            BitVector expected = whole.Decode(encoded);
+            BitVector decoded;
+            for(int at = 0; at < encoded.Length();) {
+                int count = std::min<int>(encoded.Length() - at, rng() % 70);
+                decoded += split.DecodeStream(encoded.Extract(at, count));
+                at += count;
+            }
+            assert(decoded == expected);
+        }
+    }
+
+    // A switch scheduled at GetStage() while a stream holds a partial or an odd
+    //   radix 4 stage applies at the same stage as when scheduled up front.
+    for(uint32_t radix = 2; radix <= 4; radix += 2) {
+        for(int lead = 1; lead <= 3; lead++) {
+            ConvolutionalEncoder712 encoder;
+            BitVector encoded = NoisyInput(encoder, 30 * 10, 30, rng);
+
+            ViterbiDecoder712H whole, split;
+            whole.SetRadix(radix);
+            split.SetRadix(radix);
+
+            BitVector decoded = split.DecodeStream(encoded.Extract(0, lead));
+            int64_t stage = split.GetStage();
+            split.SchedulePuncturePattern(PuncturePattern712_34, Traceback712_34, stage);
+            decoded += split.DecodeStream(encoded.Extract(lead, 60));
+            decoded += split.Flush();
+
+            whole.SchedulePuncturePattern(PuncturePattern712_34, Traceback712_34, stage);
+            BitVector expected = whole.DecodeStream(encoded.Extract(0, lead + 60));
+            expected += whole.Flush();
+            assert(decoded == expected);
+        }
+    }
+}
+
+// The channel bank matches a ViterbiDecoder712H per channel, with jobs given out
+//   of channel order and several consecutive jobs for one channel in a batch.
+static void ChannelBankCheck()
+{
+    std::mt19937 rng(28);
+    const int channels = 16;
+
+    for(int p = 0; p < 4; p++) {
+        ViterbiChannelBank712 bank(channels);
+        bank.SetPuncturePattern(CheckPatterns[p]);
+        bank.SetTracebackDepth(CheckDepths[p]);
+
+        std::vector<ViterbiDecoder712H> decoders(channels);
+        std::vector<ConvolutionalEncoder712> encoders(channels);
+        for(int c = 0; c < channels; c++) {
+            decoders[c].SetPuncturePattern(CheckPatterns[p]);
+            decoders[c].SetTracebackDepth(CheckDepths[p]);
+            encoders[c].SetPuncturePattern(CheckPatterns[p]);
+        }
+
+        for(int batch = 0; batch < 20; batch++) {
+            // Random channels, each channel's jobs are consecutive parts of its stream
+            //   in the order given. Expected output is decoded in that order.
+            std::vector<BitVector> inputs, expected;
+            std::vector<int> order;
+            for(int j = 0; j < 4 * channels; j++) {
+                int c = rng() % channels;
+                inputs.push_back(NoisyInput(encoders[c], 30 * (1 + rng() % 4), 15, rng));
+                expected.push_back(decoders[c].Decode(inputs.back()));
+                order.push_back(c);
+            }
+
+            std::vector<ChannelJob712> jobs;
+            for(int j = 0; j < (int)inputs.size(); j++) {
+                jobs.push_back(ChannelJob712{ order[j], &inputs[j], BitVector() });
+            }
+            bank.DecodeBatch(jobs);
+
+            for(ChannelJob712 &job : jobs) {
+                assert(job.output == expected[job.input - &inputs[0]]);
+            }
+        }
+    }
+}
+
+// RS(255,223) corrects up to 16 symbol errors, with more the decode fails and
+//   leaves the codeword unchanged.
+static void ReedSolomonCheck()
+{
+    const int N = ReedSolomon255_223::N;
+    std::mt19937 rng(36);
+    ReedSolomon255_223 rs;
+    uint8_t codeword[N], received[N], corrupted[N];
+    std::vector<int> positions(N);
+
+    for(int errors = 0; errors <= 24; errors++) {
+        for(int trial = 0; trial < 4; trial++) {
+            for(int k = 0; k < ReedSolomon255_223::K; k++) {
+                codeword[k] = rng();
+            }
+            rs.Encode(codeword);
+
+            // Distinct positions, nonzero error values
+            memcpy(received, codeword, N);
+            std::iota(positions.begin(), positions.end(), 0);
+            std::shuffle(positions.begin(), positions.end(), rng);
+            for(int i = 0; i < errors; i++) {
+                received[positions[i]] ^= 1 + rng() % 255;
+            }
+            memcpy(corrupted, received, N);
+
+            int corrected = rs.Decode(received);
+            if(errors <= 16) {
+                assert(corrected == errors);
+                assert(memcmp(received, codeword, N) == 0);
+            } else {
+                assert(corrected == -1);
+                assert(memcmp(received, corrupted, N) == 0);
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc > 1 && strcmp(argv[1], "benchmark") == 0) {
+        ReducedStateBenchmark();
+        return 0;
+    }
+
     BitVector input, encoded, decoded;
 
     // Create encoder and decoder. Match puncture patterns.
@@ -31,5 +578,16 @@ int main()
 
     assert(input == decoded);
 
+    ReducedStateCheck();
+    ReedSolomonCheck();
+    Radix4Check();
+    FlushLatencyCheck();
+    ScheduleCheck();
+    SurvivorEngineCheck();
+    ConcatenatedCheck();
+    BitslicedCheck();
+    StreamSplitCheck();
+    ChannelBankCheck();
+
     return 0;
 }
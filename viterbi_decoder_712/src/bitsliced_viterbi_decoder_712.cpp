@@ -0,0 +1,244 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "bitsliced_viterbi_decoder_712.h"
+
+#include <algorithm>
+
+// Start metric of every non-zero state, as modulo 64 metrics can not hold the
+//   scalar decoder's large start metric. Any start above the 12 a path can gain
+//   in the 6 stages needed to reach all states behaves the same, and 13 keeps
+//   every metric within 13 + 12 + 2 < 32 of each other.
+static const uint64_t StartMetric = 13;
+
+// metric + branch metric (2 bit planes) modulo 64
+static inline void Add(const uint64_t *metric, uint64_t low, uint64_t high, uint64_t *sum)
+{
+    uint64_t carry = metric[0] & low;
+    sum[0] = metric[0] ^ low;
+    sum[1] = metric[1] ^ high ^ carry;
+    carry = (metric[1] & high) | (carry & (metric[1] ^ high));
+    for(int b = 2; b < 6; b++) {
+        sum[b] = metric[b] ^ carry;
+        carry &= metric[b];
+    }
+}
+
+// Set where b < a, from the sign of b - a computed as b + ~a + 1.
+static inline uint64_t Less(const uint64_t *b, const uint64_t *a)
+{
+    uint64_t carry = ~(uint64_t)0;
+    for(int i = 0; i < 5; i++) {
+        uint64_t x = b[i] ^ ~a[i];
+        carry = (b[i] & ~a[i]) | (carry & x);
+    }
+    return b[5] ^ ~a[5] ^ carry;
+}
+
+// b where mask is set, a elsewhere
+static inline void Select(uint64_t mask, const uint64_t *a, const uint64_t *b, uint64_t *out)
+{
+    for(int i = 0; i < 6; i++) {
+        out[i] = a[i] ^ ((a[i] ^ b[i]) & mask);
+    }
+}
+
+BitslicedViterbiDecoder712H::BitslicedViterbiDecoder712H()
+{
+    puncturePattern = PuncturePattern712_12;
+    tracebackDepth = Traceback712_12;
+    Reset();
+}
+
+void BitslicedViterbiDecoder712H::SetTracebackDepth(uint32_t depth)
+{
+    assert(depth >= 6);
+    tracebackDepth = depth;
+    Reset();
+}
+
+uint32_t BitslicedViterbiDecoder712H::GetTracebackDepth() const
+{
+    return tracebackDepth;
+}
+
+void BitslicedViterbiDecoder712H::SetPuncturePattern(const BitVector &pattern)
+{
+    puncturePattern = pattern;
+
+    if(puncturePattern.Size() == 0) {
+        puncturePattern = PuncturePattern712_12;
+    }
+
+    assert((puncturePattern.Size() % N) == 0);
+    Reset();
+}
+
+BitVector BitslicedViterbiDecoder712H::GetPuncturePattern() const
+{
+    return puncturePattern;
+}
+
+std::vector<uint64_t> BitslicedViterbiDecoder712H::Decode(const std::vector<uint64_t> &input)
+{
+    assert(input.size() % puncturePattern.Ones() == 0);
+
+    const int stages = (input.size() / puncturePattern.Ones()) * (puncturePattern.Length() / N);
+    std::vector<uint64_t> decoded(stages);
+
+    int srcIndex = 0;
+    int punctureIndex = 0;
+
+    for(int i = 0; i < stages; i++) {
+        // Received bits, punctured bits are ignored through the mask.
+        uint64_t s[2], p[2];
+        for(int k = 0; k < 2; k++) {
+            p[k] = puncturePattern[punctureIndex + k] ? ~(uint64_t)0 : 0;
+            s[k] = p[k] ? input[srcIndex++] : 0;
+        }
+        punctureIndex += 2;
+        if(punctureIndex >= puncturePattern.Size()) {
+            punctureIndex = 0;
+        }
+
+        // Branch metric planes for each output code, a sum of two disagreements.
+        uint64_t bmLow[4], bmHigh[4];
+        for(int code = 0; code < 4; code++) {
+            uint64_t e0 = (s[0] ^ ((code & 2) ? ~(uint64_t)0 : 0)) & p[0];
+            uint64_t e1 = (s[1] ^ ((code & 1) ? ~(uint64_t)0 : 0)) & p[1];
+            bmLow[code] = e0 ^ e1;
+            bmHigh[code] = e0 & e1;
+        }
+
+        survivorSlot++;
+        if(survivorSlot >= survivorStages) {
+            survivorSlot = 0;
+        }
+
+        // Same butterfly and tie breaking as ViterbiDecoder712H.
+        for(uint32_t state = 0; state < 32; state++) {
+            uint32_t code = (ButterflyCodes712 >> (2 * state)) & 3;
+
+            uint64_t fm0[METRIC_BITS], fm1[METRIC_BITS];
+            Add(prevMetric[state], bmLow[code], bmHigh[code], fm0);
+            Add(prevMetric[state+32], bmLow[code^3], bmHigh[code^3], fm1);
+            uint64_t p1 = Less(fm1, fm0);
+            Select(p1, fm0, fm1, currMetric[state*2]);
+
+            Add(prevMetric[state], bmLow[code^3], bmHigh[code^3], fm0);
+            Add(prevMetric[state+32], bmLow[code], bmHigh[code], fm1);
+            uint64_t p2 = Less(fm1, fm0);
+            Select(p2, fm0, fm1, currMetric[state*2+1]);
+
+            // Survivors follow the chosen predecessor. The input leaving the
+            //   state's 6 bits is the predecessor's top bit, which is the decision.
+            const uint64_t *a = &prevSurvivor[state * survivorStages];
+            const uint64_t *b = &prevSurvivor[(state + 32) * survivorStages];
+            uint64_t *even = &currSurvivor[state * 2 * survivorStages];
+            uint64_t *odd = even + survivorStages;
+            for(int j = 0; j < survivorStages; j++) {
+                uint64_t x = a[j] ^ b[j];
+                even[j] = a[j] ^ (x & p1);
+                odd[j] = a[j] ^ (x & p2);
+            }
+            even[survivorSlot] = p1;
+            odd[survivorSlot] = p2;
+        }
+
+        std::swap(prevMetric, currMetric);
+        std::swap(prevSurvivor, currSurvivor);
+        trellisTime++;
+
+        // Best state per channel by tournament, ties go to the lower state like
+        //   ViterbiDecoder712H. Only the metric and the oldest survivor bit are kept.
+        const int outputSlot = (survivorSlot + 1 < survivorStages) ? survivorSlot + 1 : 0;
+        uint64_t metric[STATES][METRIC_BITS];
+        uint64_t bit[STATES];
+        for(uint32_t state = 0; state < STATES; state += 2) {
+            uint64_t right = Less(prevMetric[state+1], prevMetric[state]);
+            Select(right, prevMetric[state], prevMetric[state+1], metric[state/2]);
+            uint64_t a = prevSurvivor[state * survivorStages + outputSlot];
+            uint64_t b = prevSurvivor[(state + 1) * survivorStages + outputSlot];
+            bit[state/2] = a ^ ((a ^ b) & right);
+        }
+        for(uint32_t count = STATES / 2; count > 1; count /= 2) {
+            for(uint32_t k = 0; k < count; k += 2) {
+                uint64_t right = Less(metric[k+1], metric[k]);
+                Select(right, metric[k], metric[k+1], metric[k/2]);
+                bit[k/2] = bit[k] ^ ((bit[k] ^ bit[k+1]) & right);
+            }
+        }
+
+        // Leading zeros until the first input is tracebackDepth stages old
+        decoded[i] = (trellisTime > (int64_t)tracebackDepth) ? bit[0] : 0;
+    }
+
+    return decoded;
+}
+
+std::vector<BitVector> BitslicedViterbiDecoder712H::Decode(const std::vector<BitVector> &inputs)
+{
+    assert(inputs.size() > 0 && inputs.size() <= (size_t)CHANNELS);
+
+    const int length = inputs[0].Length();
+    std::vector<uint64_t> words(length, 0);
+    for(size_t c = 0; c < inputs.size(); c++) {
+        assert(inputs[c].Length() == length);
+        for(int i = 0; i < length; i++) {
+            words[i] |= (uint64_t)(inputs[c][i] & 1) << c;
+        }
+    }
+
+    words = Decode(words);
+
+    std::vector<BitVector> outputs(inputs.size(), BitVector(words.size()));
+    for(size_t c = 0; c < inputs.size(); c++) {
+        for(size_t i = 0; i < words.size(); i++) {
+            outputs[c][i] = (words[i] >> c) & 1;
+        }
+    }
+
+    return outputs;
+}
+
+void BitslicedViterbiDecoder712H::Reset()
+{
+    survivorStages = tracebackDepth - 5;
+    survivorSlot = 0;
+    trellisTime = 0;
+
+    prevMetric = metricBuf[0];
+    currMetric = metricBuf[1];
+
+    // Metric 0 for the zero state, StartMetric for all others, on every channel.
+    for(uint32_t state = 0; state < STATES; state++) {
+        for(int b = 0; b < METRIC_BITS; b++) {
+            uint64_t set = (state != 0 && ((StartMetric >> b) & 1)) ? ~(uint64_t)0 : 0;
+            prevMetric[state][b] = set;
+            currMetric[state][b] = 0;
+        }
+    }
+
+    for(int i = 0; i < 2; i++) {
+        survivorBuf[i].assign(STATES * survivorStages, 0);
+    }
+    prevSurvivor = survivorBuf[0].data();
+    currSurvivor = survivorBuf[1].data();
+}
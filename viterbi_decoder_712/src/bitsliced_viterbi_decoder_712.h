@@ -0,0 +1,84 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bit_vector.h"
+#include "convolutional_encoder_712.h"
+
+// Continuous hard decision Viterbi decoding of 64 independent channels at once,
+//   sharing one puncture pattern and traceback depth.
+// Bit sliced, bit c of every word belongs to channel c. Path metrics are held as
+//   6 bit planes per state and add-compare-select uses only AND/XOR/OR, so each
+//   pass through the trellis advances all 64 channels by one stage.
+// Survivors use register exchange, one word per state per stored stage.
+// Output matches ViterbiDecoder712H::Decode for each channel.
+class BitslicedViterbiDecoder712H {
+    static const uint32_t N = 2;
+    static const uint32_t STATES = 64;
+    // Metric bit planes. Metrics are kept modulo 64, which orders them correctly
+    //   while they stay within 32 of each other.
+    static const int METRIC_BITS = 6;
+
+public:
+    static const int CHANNELS = 64;
+
+    BitslicedViterbiDecoder712H();
+
+    // Setting a new traceback depth resets all channels. Depth must be at least 6.
+    void SetTracebackDepth(uint32_t depth);
+    uint32_t GetTracebackDepth() const;
+
+    // Setting a new puncture pattern resets all channels.
+    void SetPuncturePattern(const BitVector &pattern);
+    BitVector GetPuncturePattern() const;
+
+    // Input word i holds received (punctured) bit i of every channel.
+    // Length must be multiple of the puncture pattern ones.
+    // Returns one word per trellis stage in the same layout.
+    std::vector<uint64_t> Decode(const std::vector<uint64_t> &input);
+
+    // Per channel form of Decode. Up to 64 equal length inputs, channel c is inputs[c].
+    std::vector<BitVector> Decode(const std::vector<BitVector> &inputs);
+
+    // Resets all channels.
+    void Reset();
+
+private:
+    BitVector puncturePattern;
+    uint32_t tracebackDepth;
+    // Stored survivor stages. The newest 6 inputs of a path are its state.
+    int survivorStages;
+    // Survivor slot written by the last stage, slots rotate instead of shifting.
+    int survivorSlot;
+    // Trellis stages since reset, the first tracebackDepth outputs are zero.
+    int64_t trellisTime;
+
+    // Path metric planes, metric[state][bit]
+    uint64_t metricBuf[2][STATES][METRIC_BITS];
+    uint64_t (*prevMetric)[METRIC_BITS], (*currMetric)[METRIC_BITS];
+    // Survivor planes, survivorStages words per state. Word j of a state holds
+    //   the input of every stage whose slot is j.
+    std::vector<uint64_t> survivorBuf[2];
+    uint64_t *prevSurvivor, *currSurvivor;
+};
@@ -0,0 +1,148 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "concatenated_decoder_712.h"
+
+static const int N = ReedSolomon255_223::N;
+static const int K = ReedSolomon255_223::K;
+// Zero bits returning the inner encoder to the zero state
+static const int TailBits = 6;
+static const int MaxInterleave = 8;
+
+ConcatenatedEncoder712::ConcatenatedEncoder712()
+{
+    interleave = 1;
+    puncturePattern = PuncturePattern712_12;
+    inner.SetPuncturePattern(puncturePattern);
+}
+
+void ConcatenatedEncoder712::SetInterleave(int depth)
+{
+    assert(depth >= 1 && depth <= MaxInterleave);
+    interleave = depth;
+}
+
+int ConcatenatedEncoder712::GetInterleave() const
+{
+    return interleave;
+}
+
+void ConcatenatedEncoder712::SetPuncturePattern(const BitVector &pattern)
+{
+    inner.SetPuncturePattern(pattern);
+    puncturePattern = (pattern.Size() == 0) ? PuncturePattern712_12 : pattern;
+}
+
+BitVector ConcatenatedEncoder712::GetPuncturePattern() const
+{
+    return puncturePattern;
+}
+
+BitVector ConcatenatedEncoder712::Encode(const std::vector<uint8_t> &data)
+{
+    assert((int)data.size() == K * interleave);
+
+    codewords.resize(N * interleave);
+    for(int k = 0; k < K * interleave; k++) {
+        codewords[(k % interleave) * N + k / interleave] = data[k];
+    }
+    for(int j = 0; j < interleave; j++) {
+        rs.Encode(&codewords[j * N]);
+    }
+
+    // Tail zeros are extended to complete the last puncture period
+    int periodStages = puncturePattern.Size() / 2;
+    int frameBits = 8 * N * interleave + TailBits;
+    BitVector bits(((frameBits + periodStages - 1) / periodStages) * periodStages);
+    int pos = 0;
+    for(int k = 0; k < N * interleave; k++) {
+        uint8_t symbol = codewords[(k % interleave) * N + k / interleave];
+        for(int bit = 7; bit >= 0; bit--) {
+            bits[pos++] = (symbol >> bit) & 1;
+        }
+    }
+    while(pos < bits.Length()) {
+        bits[pos++] = 0;
+    }
+
+    inner.Reset();
+    return inner.Encode(bits);
+}
+
+ConcatenatedDecoder712::ConcatenatedDecoder712()
+{
+    interleave = 1;
+}
+
+void ConcatenatedDecoder712::SetInterleave(int depth)
+{
+    assert(depth >= 1 && depth <= MaxInterleave);
+    interleave = depth;
+}
+
+int ConcatenatedDecoder712::GetInterleave() const
+{
+    return interleave;
+}
+
+void ConcatenatedDecoder712::SetPuncturePattern(const BitVector &pattern)
+{
+    inner.SetPuncturePattern(pattern);
+}
+
+BitVector ConcatenatedDecoder712::GetPuncturePattern() const
+{
+    return inner.GetPuncturePattern();
+}
+
+void ConcatenatedDecoder712::SetTracebackDepth(uint32_t depth)
+{
+    inner.SetTracebackDepth(depth);
+}
+
+uint32_t ConcatenatedDecoder712::GetTracebackDepth() const
+{
+    return inner.GetTracebackDepth();
+}
+
+void ConcatenatedDecoder712::Decode(const BitVector &input, ConcatenatedFrame712 &frame)
+{
+    BitVector bits = inner.DecodeTerminated(input);
+    assert(bits.Length() >= 8 * N * interleave);
+
+    // Pack bits straight into their deinterleaved codeword positions
+    codewords.resize(N * interleave);
+    const uint8_t *b = &bits[0];
+    for(int k = 0; k < N * interleave; k++, b += 8) {
+        codewords[(k % interleave) * N + k / interleave] =
+                (b[0] << 7) | (b[1] << 6) | (b[2] << 5) | (b[3] << 4) |
+                (b[4] << 3) | (b[5] << 2) | (b[6] << 1) | b[7];
+    }
+
+    frame.corrected.resize(interleave);
+    for(int j = 0; j < interleave; j++) {
+        frame.corrected[j] = rs.Decode(&codewords[j * N]);
+    }
+
+    frame.data.resize(K * interleave);
+    for(int k = 0; k < K * interleave; k++) {
+        frame.data[k] = codewords[(k % interleave) * N + k / interleave];
+    }
+}
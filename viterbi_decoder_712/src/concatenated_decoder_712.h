@@ -0,0 +1,95 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bit_vector.h"
+#include "convolutional_encoder_712.h"
+#include "reed_solomon_255_223.h"
+#include "viterbi_decoder_712.h"
+
+// One decoded concatenated frame.
+struct ConcatenatedFrame712 {
+    // Information bytes, 223 * interleave, in transmitted order.
+    std::vector<uint8_t> data;
+    // Corrected symbols per codeword, -1 when uncorrectable.
+    std::vector<int> corrected;
+};
+
+// CCSDS style concatenated coding, RS(255,223) outer code with symbol interleaving
+//   of depth I and the 7,1,2 convolutional inner code.
+// A frame is I codewords, 255 * I bytes sent most significant bit first.
+//   Byte k of the frame is symbol k / I of codeword k % I, so the first 223 * I
+//   bytes are data and the last 32 * I are parity.
+// The inner code is terminated after each frame with 6 zero tail bits, extended
+//   to complete the last puncture period.
+class ConcatenatedEncoder712 {
+public:
+    ConcatenatedEncoder712();
+
+    // Interleave depth I, [1, 8]
+    void SetInterleave(int depth);
+    int GetInterleave() const;
+
+    void SetPuncturePattern(const BitVector &pattern);
+    BitVector GetPuncturePattern() const;
+
+    // Frame data of 223 * I bytes in, encoded and punctured frame out.
+    BitVector Encode(const std::vector<uint8_t> &data);
+
+private:
+    ReedSolomon255_223 rs;
+    ConvolutionalEncoder712 inner;
+    BitVector puncturePattern;
+    int interleave;
+    std::vector<uint8_t> codewords;
+};
+
+// Decodes frames from ConcatenatedEncoder712.
+// Viterbi output is packed straight into the interleaved codewords, which are
+//   decoded in place, so a frame is touched once after the inner decode.
+class ConcatenatedDecoder712 {
+public:
+    ConcatenatedDecoder712();
+
+    // Interleave depth I, [1, 8]
+    void SetInterleave(int depth);
+    int GetInterleave() const;
+
+    void SetPuncturePattern(const BitVector &pattern);
+    BitVector GetPuncturePattern() const;
+
+    void SetTracebackDepth(uint32_t depth);
+    uint32_t GetTracebackDepth() const;
+
+    // Input is one encoded and punctured frame, including the tail.
+    // frame storage is reused across calls.
+    void Decode(const BitVector &input, ConcatenatedFrame712 &frame);
+
+private:
+    ReedSolomon255_223 rs;
+    ViterbiDecoder712H inner;
+    int interleave;
+    // Codeword j at [j * 255, (j + 1) * 255)
+    std::vector<uint8_t> codewords;
+};
@@ -1,33 +1,19 @@
 #include "convolutional_encoder_712.h"
 
-static uint64_t Popcount(uint64_t n)
-{
-    int i = 0;
-    for(; n != 0; n &= n - 1) {
-        i++;
-    }
-    return i;
-}
-
 Trellis712::Trellis712()
 {
-    const uint32_t g[2] = { 0x6D, 0x4F };
-
     uint32_t stateMask = (64 - 1);
 
     // Build state diagram
     for(int i = 0; i < 64; i++) {
         for(int j = 0; j < 2; j++) {
             // Calculate output
-            uint32_t reg = (i*2) | j;
-
-            for(int k = 0; k < 2; k++) {
-                uint32_t output = reg & g[k];
-                outputs[i][j][k] = Popcount(output) & 1;
-            }
+            uint32_t code = OutputCode712(i, j);
+            outputs[i][j][0] = code >> 1;
+            outputs[i][j][1] = code & 1;
 
             // Calculate next state
-            reg = (reg & stateMask);
+            uint32_t reg = ((i*2) | j) & stateMask;
 
             nextState[i][j] = reg;
         }
@@ -37,7 +23,7 @@ Trellis712::Trellis712()
 ConvolutionalEncoder712::ConvolutionalEncoder712()
 {
     puncturePattern = PuncturePattern712_12;
-    currentState = 0;
+    Reset();
 }
 
 void ConvolutionalEncoder712::SetPuncturePattern(const BitVector &newPattern)
@@ -52,21 +38,57 @@ void ConvolutionalEncoder712::SetPuncturePattern(const BitVector &newPattern)
     Reset();
 }
 
+void ConvolutionalEncoder712::SchedulePuncturePattern(const BitVector &newPattern, int64_t position)
+{
+    const BitVector &before = schedule.empty() ? puncturePattern : schedule.back().pattern;
+    assert(position >= lastPatternPosition && position >= bitPosition);
+    assert(((position - lastPatternPosition) % (before.Size() / 2)) == 0);
+
+    ScheduledPattern next;
+    next.position = position;
+    next.pattern = (newPattern.Size() == 0) ? PuncturePattern712_12 : newPattern;
+    assert((next.pattern.Size() % 2) == 0);
+    schedule.push_back(next);
+    lastPatternPosition = position;
+}
+
+int64_t ConvolutionalEncoder712::GetBitPosition() const
+{
+    return bitPosition;
+}
+
 BitVector ConvolutionalEncoder712::Encode(const BitVector &input)
 {
     assert(input.Size() > 0);
+    assert(punctureIx == 0);
+
+    BitVector encoded = EncodeStream(input);
+
+    // Encoded length must be a multiple of the puncture pattern size
+    assert(punctureIx == 0);
+
+    return encoded;
+}
+
+BitVector ConvolutionalEncoder712::EncodeStream(const BitVector &input)
+{
     assert(puncturePattern.Size() > 0);
-    assert(((2 * input.Size()) % puncturePattern.Size()) == 0);
 
-    const int encodedLength = 2 * (puncturePattern.Ones() * input.Size()) / puncturePattern.Size();
-    BitVector encoded(encodedLength);
+    // Never more than two output bits per input
+    BitVector encoded(2 * input.Size());
 
     // Index into encoded buffer
     int encodedIx = 0;
-    // Index into puncture pattern
-    int punctureIx = 0;
 
     for(int i = 0; i < input.Size(); i++) {
+        // Switch patterns at the start of the period they are scheduled for
+        if(punctureIx == 0) {
+            while(!schedule.empty() && schedule.front().position == bitPosition) {
+                puncturePattern = schedule.front().pattern;
+                schedule.pop_front();
+            }
+        }
+
         // Insert two output bits into encoded array only if puncture bit is set to 1
         for(int bit = 0; bit < 2; bit++) {
             if(puncturePattern[punctureIx++]) {
@@ -75,15 +97,21 @@ BitVector ConvolutionalEncoder712::Encode(const BitVector &input)
         }
 
         currentState = trellis.nextState[currentState][input[i]];
+        bitPosition++;
         if(punctureIx >= puncturePattern.Size()) {
             punctureIx = 0;
         }
     }
 
+    encoded.Resize(encodedIx);
     return encoded;
 }
 
 void ConvolutionalEncoder712::Reset()
 {
     currentState = 0;
+    punctureIx = 0;
+    bitPosition = 0;
+    schedule.clear();
+    lastPatternPosition = 0;
 }
@@ -21,6 +21,7 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
 #include <vector>
 
 #include "bit_vector.h"
@@ -36,6 +37,35 @@ const uint32_t Traceback712_23 = 45;
 const uint32_t Traceback712_34 = 60;
 const uint32_t Traceback712_56 = 90;
 
+// Generator polynomials [171 133] in shift register bit order,
+// bit 0 is the newest input.
+const uint32_t Generator712A = 0x6D;
+const uint32_t Generator712B = 0x4F;
+
+constexpr uint32_t Parity712(uint32_t v)
+{
+    return (v == 0) ? 0 : ((v & 1) ^ Parity712(v >> 1));
+}
+
+// Output pair of the transition from state on input, as a 2 bit code.
+// The first output is the high bit.
+constexpr uint32_t OutputCode712(uint32_t state, uint32_t input)
+{
+    return (Parity712(((state << 1) | input) & Generator712A) << 1) |
+            Parity712(((state << 1) | input) & Generator712B);
+}
+
+constexpr uint64_t PackButterflyCodes712(uint32_t state)
+{
+    return (state == 32) ? 0 :
+            (((uint64_t)OutputCode712(state, 0) << (2 * state)) | PackButterflyCodes712(state + 1));
+}
+
+// Output codes for an input of zero from states [0,32), two bits per state.
+// Every other transition of a butterfly is derived from these,
+//   [s] -> 1 and [s+32] -> 0 output code ^ 3, [s+32] -> 1 outputs the same code.
+constexpr uint64_t ButterflyCodes712 = PackButterflyCodes712(0);
+
 // Characteristics of this trellis/polynomial,
 // If you are in an even numbered state [0,2,4,...] an input of zero caused you to
 //   reach this state. If you are in an odd numbered state, an input of 1 caused you
@@ -59,15 +89,42 @@ public:
     // Updating the puncture pattern resets the encoder.
     void SetPuncturePattern(const BitVector &newPattern);
 
+    // Schedules a new puncture pattern to take effect at input bit 'position'
+    //   (bits encoded since the last reset) without resetting the encoder.
+    // The position must fall on a puncture period boundary of the pattern used before it,
+    //   and switches must be scheduled in position order.
+    // Scheduled switches are cleared on reset.
+    void SchedulePuncturePattern(const BitVector &newPattern, int64_t position);
+    // Input bits encoded since the last reset.
+    int64_t GetBitPosition() const;
+
     // Main encode routine. Returns punctured bit vector.
-    // Encoded length (inputSize*2) must be a multiple of the puncture pattern size.
+    // Encoded length (inputSize*2) must be a multiple of the puncture pattern size,
+    //   for each pattern the input covers.
     BitVector Encode(const BitVector &input);
+    // Same as Encode, but input may be any length. The puncture pattern position
+    //   carries over to the next call, so buffers encode as if they were one.
+    BitVector EncodeStream(const BitVector &input);
 
     // Resets the internal running state of the encoder.
     void Reset();
 
 private:
+    struct ScheduledPattern {
+        int64_t position;
+        BitVector pattern;
+    };
+
     Trellis712 trellis;
     BitVector puncturePattern;
     uint8_t currentState;
+    // Index into the puncture pattern, only nonzero between EncodeStream calls
+    //   that end inside a period.
+    int punctureIx;
+    // Input bits encoded since reset
+    int64_t bitPosition;
+    // Pending pattern switches in position order
+    std::deque<ScheduledPattern> schedule;
+    // Position at which the last scheduled (or current) pattern starts
+    int64_t lastPatternPosition;
 };
@@ -0,0 +1,898 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "decode_service_712.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Ring indices must be lock free to be shared between processes");
+
+// Bytes of the bit count in front of every record
+static const uint64_t RecordHeaderBytes = sizeof(uint32_t);
+// Ring capacity limits accepted by OPEN
+static const uint64_t MinRingBytes = 4096;
+static const uint64_t MaxRingBytes = 1ull << 30;
+// Stream input bits decoded at once, so their output (without the traceback
+//   depth) fits in a quarter of the ring. Zero if no slice fits.
+static uint64_t StreamSliceBits(const BitVector &pattern, uint64_t capacity)
+{
+    uint64_t periods = (capacity / 4) / (pattern.Length() / 2);
+    return (periods > 2) ? (periods - 2) * pattern.Ones() : 0;
+}
+
+// Idle workers wait this long for the doorbell, clients that never ring are
+//   still served.
+static const int IdleTimeoutMs = 10;
+
+DecodeRing712::DecodeRing712()
+{
+    header = nullptr;
+    data = nullptr;
+    capacity = 0;
+    mask = 0;
+}
+
+void DecodeRing712::Create(void *memory, uint64_t ringCapacity)
+{
+    assert(ringCapacity > 0 && (ringCapacity & (ringCapacity - 1)) == 0);
+    header = new (memory) DecodeRingHeader712;
+    header->magic = DecodeRingMagic712;
+    header->version = DecodeRingVersion712;
+    header->capacity = ringCapacity;
+    header->head.store(0);
+    header->tail.store(0);
+    data = (uint8_t *)memory + sizeof(DecodeRingHeader712);
+    capacity = ringCapacity;
+    mask = ringCapacity - 1;
+}
+
+bool DecodeRing712::Attach(void *memory, uint64_t ringCapacity)
+{
+    assert(ringCapacity > 0 && (ringCapacity & (ringCapacity - 1)) == 0);
+    header = (DecodeRingHeader712 *)memory;
+    data = (uint8_t *)memory + sizeof(DecodeRingHeader712);
+    capacity = ringCapacity;
+    mask = ringCapacity - 1;
+    return header->magic == DecodeRingMagic712 && header->version == DecodeRingVersion712 &&
+            header->capacity == ringCapacity;
+}
+
+bool DecodeRing712::Write(const uint8_t *bits, uint32_t count)
+{
+    if(RecordBytes(count) > Free()) {
+        return false;
+    }
+
+    // Only the producer moves head
+    uint64_t head = header->head.load(std::memory_order_relaxed);
+    CopyIn(head, &count, RecordHeaderBytes);
+    CopyIn(head + RecordHeaderBytes, bits, count);
+    header->head.store(head + RecordBytes(count), std::memory_order_release);
+    return true;
+}
+
+bool DecodeRing712::Write(const BitVector &bits)
+{
+    return Write(bits.Length() ? &bits[0] : nullptr, bits.Length());
+}
+
+bool DecodeRing712::Peek(uint32_t &count) const
+{
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    if(header->head.load(std::memory_order_acquire) == tail) {
+        return false;
+    }
+    CopyOut(tail, &count, RecordHeaderBytes);
+    return true;
+}
+
+bool DecodeRing712::Read(BitVector &bits)
+{
+    uint32_t count;
+    if(!Peek(count)) {
+        return false;
+    }
+    bits.Resize(count);
+    if(count > 0) {
+        CopyOut(0, count, &bits[0]);
+    }
+    Pop();
+    return true;
+}
+
+void DecodeRing712::CopyOut(uint32_t first, uint32_t count, uint8_t *bits) const
+{
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    CopyOut(tail + RecordHeaderBytes + first, bits, count);
+}
+
+void DecodeRing712::Pop()
+{
+    uint32_t count;
+    uint64_t tail = header->tail.load(std::memory_order_relaxed);
+    CopyOut(tail, &count, RecordHeaderBytes);
+    header->tail.store(tail + RecordBytes(count), std::memory_order_release);
+}
+
+uint64_t DecodeRing712::Capacity() const
+{
+    return capacity;
+}
+
+uint64_t DecodeRing712::Free() const
+{
+    uint64_t used = header->head.load(std::memory_order_relaxed) -
+            header->tail.load(std::memory_order_acquire);
+    return (used <= capacity) ? capacity - used : 0;
+}
+
+uint64_t DecodeRing712::Used() const
+{
+    return header->head.load(std::memory_order_acquire) -
+            header->tail.load(std::memory_order_relaxed);
+}
+
+uint64_t DecodeRing712::RecordBytes(uint32_t count)
+{
+    return RecordHeaderBytes + count;
+}
+
+void DecodeRing712::CopyIn(uint64_t position, const void *source, uint64_t bytes)
+{
+    uint64_t offset = position & mask;
+    uint64_t first = std::min(bytes, capacity - offset);
+    memcpy(data + offset, source, first);
+    memcpy(data, (const uint8_t *)source + first, bytes - first);
+}
+
+void DecodeRing712::CopyOut(uint64_t position, void *destination, uint64_t bytes) const
+{
+    uint64_t offset = position & mask;
+    uint64_t first = std::min(bytes, capacity - offset);
+    memcpy(destination, data + offset, first);
+    memcpy((uint8_t *)destination + first, data, bytes - first);
+}
+
+// Sends a whole line, false if the connection failed.
+// A file descriptor other than -1 is passed along with the first bytes.
+static bool SendLine(int connection, const std::string &line, int fd = -1)
+{
+    std::string text = line + "\n";
+    size_t sent = 0;
+    while(sent < text.size()) {
+        iovec data = { (void *)(text.data() + sent), text.size() - sent };
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+
+        char control[CMSG_SPACE(sizeof(int))] = {};
+        if(fd >= 0) {
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            memcpy(CMSG_DATA(header), &fd, sizeof(int));
+        }
+
+        ssize_t n = sendmsg(connection, &message, MSG_NOSIGNAL);
+        if(n <= 0) {
+            return false;
+        }
+        sent += n;
+        fd = -1;
+    }
+    return true;
+}
+
+// Receives one line without the newline, false if the connection closed first.
+// A passed file descriptor is stored in fd when given, otherwise closed.
+static bool ReceiveLine(int connection, std::string &line, int *fd = nullptr)
+{
+    line.clear();
+    char c;
+    for(;;) {
+        iovec data = { &c, 1 };
+        char control[CMSG_SPACE(sizeof(int))];
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if(recvmsg(connection, &message, 0) != 1) {
+            return false;
+        }
+
+        for(cmsghdr *header = CMSG_FIRSTHDR(&message); header; header = CMSG_NXTHDR(&message, header)) {
+            if(header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+                int passed;
+                memcpy(&passed, CMSG_DATA(header), sizeof(int));
+                if(fd && *fd < 0) {
+                    *fd = passed;
+                } else {
+                    close(passed);
+                }
+            }
+        }
+
+        if(c == '\n') {
+            return true;
+        }
+        line.push_back(c);
+    }
+}
+
+static BitVector ParsePattern(const std::string &text)
+{
+    BitVector pattern;
+    for(char c : text) {
+        if(c != '0' && c != '1') {
+            return BitVector();
+        }
+        pattern.PushBack(c - '0');
+    }
+    return pattern;
+}
+
+DecodeClient712::DecodeClient712()
+{
+    socket = -1;
+    doorbell = -1;
+    segment = nullptr;
+    segmentBytes = 0;
+}
+
+DecodeClient712::~DecodeClient712()
+{
+    Close();
+}
+
+bool DecodeClient712::Open(const std::string &socketPath, bool frameMode, const BitVector &pattern,
+                           uint32_t depth, uint64_t ringBytes)
+{
+    Close();
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(socket < 0 || connect(socket, (sockaddr *)&address, sizeof(address)) != 0) {
+        Close();
+        return false;
+    }
+
+    std::ostringstream request;
+    request << "OPEN " << (frameMode ? "frame" : "stream") << " " << pattern.ToString() << " "
+            << depth << " " << ringBytes;
+
+    std::string reply;
+    if(!SendLine(socket, request.str()) || !ReceiveLine(socket, reply, &doorbell) ||
+            reply.compare(0, 3, "OK ") != 0) {
+        Close();
+        return false;
+    }
+
+    int fd = shm_open(reply.substr(3).c_str(), O_RDWR, 0);
+    if(fd < 0) {
+        Close();
+        return false;
+    }
+    segmentBytes = 2 * DecodeRingBytes712(ringBytes);
+    segment = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(segment == MAP_FAILED) {
+        segment = nullptr;
+        Close();
+        return false;
+    }
+
+    if(!input.Attach(segment, ringBytes) ||
+            !output.Attach((uint8_t *)segment + DecodeRingBytes712(ringBytes), ringBytes)) {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void DecodeClient712::Close()
+{
+    if(socket >= 0) {
+        SendLine(socket, "CLOSE");
+        close(socket);
+        socket = -1;
+    }
+    if(doorbell >= 0) {
+        close(doorbell);
+        doorbell = -1;
+    }
+    if(segment) {
+        munmap(segment, segmentBytes);
+        segment = nullptr;
+    }
+}
+
+bool DecodeClient712::Write(const BitVector &bits)
+{
+    if(!input.Write(bits)) {
+        return false;
+    }
+    Ring();
+    return true;
+}
+
+bool DecodeClient712::Read(BitVector &bits)
+{
+    // The freed space may be what a worker waits for
+    if(!output.Read(bits)) {
+        return false;
+    }
+    Ring();
+    return true;
+}
+
+void DecodeClient712::Ring()
+{
+    if(doorbell >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(doorbell, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+bool DecodeClient712::Flush(BitVector &bits)
+{
+    if(socket < 0 || !SendLine(socket, "FLUSH")) {
+        return false;
+    }
+
+    // Keep reading output while waiting, the flushed record needs room in the ring
+    BitVector record;
+    std::string reply;
+    while(true) {
+        while(output.Read(record)) {
+            bits += record;
+        }
+        pollfd fd = { socket, POLLIN, 0 };
+        if(poll(&fd, 1, 1) > 0) {
+            if(!ReceiveLine(socket, reply)) {
+                return false;
+            }
+            break;
+        }
+    }
+    while(output.Read(record)) {
+        bits += record;
+    }
+    return reply == "OK";
+}
+
+DecodeRing712 &DecodeClient712::Input()
+{
+    return input;
+}
+
+DecodeRing712 &DecodeClient712::Output()
+{
+    return output;
+}
+
+DecodeService712::DecodeService712()
+{
+    workers = std::max(1u, std::thread::hardware_concurrency());
+    batchBits = 1 << 16;
+    running = false;
+    wakePipe[0] = wakePipe[1] = -1;
+    doorbell = -1;
+    sessionCount = 0;
+}
+
+DecodeService712::~DecodeService712()
+{
+    Stop();
+}
+
+void DecodeService712::SetWorkers(int count)
+{
+    assert(count > 0 && !running);
+    workers = count;
+}
+
+int DecodeService712::GetWorkers() const
+{
+    return workers;
+}
+
+void DecodeService712::SetBatchBits(uint32_t bits)
+{
+    assert(bits > 0 && !running);
+    batchBits = bits;
+}
+
+uint32_t DecodeService712::GetBatchBits() const
+{
+    return batchBits;
+}
+
+bool DecodeService712::Run(const std::string &socketPath)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if(socketPath.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    strcpy(address.sun_path, socketPath.c_str());
+
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(socketPath.c_str());
+    if(listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 ||
+            listen(listener, 16) != 0 || pipe(wakePipe) != 0) {
+        if(listener >= 0) {
+            close(listener);
+        }
+        return false;
+    }
+    doorbell = eventfd(0, EFD_NONBLOCK);
+    if(doorbell < 0) {
+        close(listener);
+        close(wakePipe[0]);
+        close(wakePipe[1]);
+        wakePipe[0] = wakePipe[1] = -1;
+        return false;
+    }
+    // Workers never block on a full pipe, a wake is already pending then.
+    fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+
+    running = true;
+    std::vector<std::thread> threads;
+    for(int i = 0; i < workers; i++) {
+        threads.emplace_back(&DecodeService712::Worker, this, i);
+    }
+
+    // Control connections and their partial lines
+    std::map<int, std::string> connections;
+    while(running) {
+        std::vector<pollfd> fds;
+        fds.push_back({ wakePipe[0], POLLIN, 0 });
+        fds.push_back({ listener, POLLIN, 0 });
+        for(const auto &connection : connections) {
+            fds.push_back({ connection.first, POLLIN, 0 });
+        }
+
+        if(poll(fds.data(), fds.size(), -1) < 0) {
+            continue;
+        }
+        if(!running) {
+            break;
+        }
+
+        if(fds[1].revents & POLLIN) {
+            int connection = accept(listener, nullptr, nullptr);
+            if(connection >= 0) {
+                connections[connection] = std::string();
+            }
+        }
+
+        for(size_t i = 2; i < fds.size(); i++) {
+            if(fds[i].revents == 0) {
+                continue;
+            }
+            int connection = fds[i].fd;
+            char buffer[256];
+            ssize_t n = recv(connection, buffer, sizeof(buffer), 0);
+            if(n <= 0) {
+                CloseSession(connection);
+                close(connection);
+                connections.erase(connection);
+                continue;
+            }
+
+            std::string &pending = connections[connection];
+            pending.append(buffer, n);
+            size_t end;
+            while((end = pending.find('\n')) != std::string::npos) {
+                std::string line = pending.substr(0, end);
+                pending.erase(0, end + 1);
+                // Empty replies are sent once a worker is done
+                bool passDoorbell = false;
+                std::string reply = Control(connection, line, passDoorbell);
+                if(!reply.empty()) {
+                    SendLine(connection, reply, passDoorbell ? doorbell : -1);
+                }
+            }
+        }
+
+        if(fds[0].revents & POLLIN) {
+            char buffer[64];
+            while(read(wakePipe[0], buffer, sizeof(buffer)) > 0) {
+            }
+
+            // Replies and closes decided by the workers, all socket writes stay on this thread
+            std::vector<int> flushed, failed;
+            {
+                std::lock_guard<std::mutex> lock(sessionsLock);
+                for(const std::shared_ptr<Session> &session : sessions) {
+                    if(session->failed) {
+                        failed.push_back(session->connection);
+                    } else if(session->flushDone.exchange(false)) {
+                        flushed.push_back(session->connection);
+                    }
+                }
+            }
+            for(int connection : flushed) {
+                SendLine(connection, "OK");
+            }
+            for(int connection : failed) {
+                CloseSession(connection);
+                close(connection);
+                connections.erase(connection);
+            }
+        }
+    }
+
+    for(std::thread &thread : threads) {
+        thread.join();
+    }
+    for(const auto &connection : connections) {
+        CloseSession(connection.first);
+        close(connection.first);
+    }
+    close(listener);
+    unlink(socketPath.c_str());
+    close(wakePipe[0]);
+    close(wakePipe[1]);
+    wakePipe[0] = wakePipe[1] = -1;
+    close(doorbell);
+    doorbell = -1;
+
+    return true;
+}
+
+void DecodeService712::Stop()
+{
+    running = false;
+    Wake();
+    Ring();
+}
+
+void DecodeService712::Wake()
+{
+    if(wakePipe[1] >= 0) {
+        char c = 0;
+        ssize_t ignored = write(wakePipe[1], &c, 1);
+        (void)ignored;
+    }
+}
+
+void DecodeService712::Ring()
+{
+    if(doorbell >= 0) {
+        uint64_t one = 1;
+        ssize_t ignored = write(doorbell, &one, sizeof(one));
+        (void)ignored;
+    }
+}
+
+int DecodeService712::Sessions() const
+{
+    std::lock_guard<std::mutex> lock(sessionsLock);
+    return sessions.size();
+}
+
+std::string DecodeService712::Control(int connection, const std::string &line, bool &passDoorbell)
+{
+    std::istringstream stream(line);
+    std::vector<std::string> args;
+    std::string arg;
+    while(stream >> arg) {
+        args.push_back(arg);
+    }
+
+    if(args.empty()) {
+        return "ERR empty request";
+    }
+    if(args[0] == "OPEN") {
+        std::string error;
+        std::shared_ptr<Session> session = OpenSession(connection, args, error);
+        if(!session) {
+            return "ERR " + error;
+        }
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        sessions.push_back(session);
+        passDoorbell = true;
+        return "OK " + session->name;
+    }
+    if(args[0] == "FLUSH") {
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        for(const std::shared_ptr<Session> &session : sessions) {
+            if(session->connection != connection) {
+                continue;
+            }
+            if(session->frameMode) {
+                return "ERR frame sessions are not flushed";
+            }
+            if(session->flushPending.exchange(true)) {
+                return "ERR flush pending";
+            }
+            Ring();
+            return std::string();
+        }
+        return "ERR no session";
+    }
+    if(args[0] == "CLOSE") {
+        CloseSession(connection);
+        return "OK";
+    }
+    return "ERR unknown request";
+}
+
+std::shared_ptr<DecodeService712::Session> DecodeService712::OpenSession(int connection,
+        const std::vector<std::string> &args, std::string &error)
+{
+    {
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        for(const std::shared_ptr<Session> &session : sessions) {
+            if(session->connection == connection) {
+                error = "session already open";
+                return nullptr;
+            }
+        }
+    }
+
+    if(args.size() != 5 || (args[1] != "stream" && args[1] != "frame")) {
+        error = "usage OPEN <stream|frame> <pattern> <depth> <ring bytes>";
+        return nullptr;
+    }
+    BitVector pattern = ParsePattern(args[2]);
+    uint32_t depth = strtoul(args[3].c_str(), nullptr, 10);
+    uint64_t capacity = strtoull(args[4].c_str(), nullptr, 10);
+    if(pattern.Length() == 0 || (pattern.Length() % 2) != 0 || pattern.Ones() == 0) {
+        error = "bad puncture pattern";
+        return nullptr;
+    }
+    if(depth == 0 || depth > 0xFFFF) {
+        error = "bad traceback depth";
+        return nullptr;
+    }
+    if(capacity < MinRingBytes || capacity > MaxRingBytes || (capacity & (capacity - 1)) != 0) {
+        error = "ring bytes must be a power of two in [4096, 2^30]";
+        return nullptr;
+    }
+    // Stream output is a slice's stages plus the pending depth, both must fit
+    //   in the output ring together or the session would never progress.
+    if(depth + pattern.Length() + RecordHeaderBytes > capacity / 4 || StreamSliceBits(pattern, capacity) == 0) {
+        error = "traceback depth or pattern too large for the ring";
+        return nullptr;
+    }
+
+    std::shared_ptr<Session> session = std::make_shared<Session>();
+    session->connection = connection;
+    session->frameMode = (args[1] == "frame");
+    session->recordOffset = 0;
+    session->flushPending = false;
+    session->flushDone = false;
+    session->failed = false;
+    session->retry = false;
+    session->decoder.SetPuncturePattern(pattern);
+    session->decoder.SetTracebackDepth(depth);
+
+    std::ostringstream name;
+    name << "/viterbi712-" << getpid() << "-" << sessionCount++;
+    session->name = name.str();
+    session->segmentBytes = 2 * DecodeRingBytes712(capacity);
+
+    int fd = shm_open(session->name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if(fd < 0) {
+        error = "shm_open failed";
+        return nullptr;
+    }
+    void *segment = MAP_FAILED;
+    if(ftruncate(fd, session->segmentBytes) == 0) {
+        segment = mmap(nullptr, session->segmentBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if(segment == MAP_FAILED) {
+        shm_unlink(session->name.c_str());
+        error = "mmap failed";
+        return nullptr;
+    }
+
+    session->segment = segment;
+    session->input.Create(segment, capacity);
+    session->output.Create((uint8_t *)segment + DecodeRingBytes712(capacity), capacity);
+    return session;
+}
+
+void DecodeService712::CloseSession(int connection)
+{
+    std::shared_ptr<Session> session;
+    {
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        for(size_t i = 0; i < sessions.size(); i++) {
+            if(sessions[i]->connection == connection) {
+                session = sessions[i];
+                sessions.erase(sessions.begin() + i);
+                break;
+            }
+        }
+    }
+    if(!session) {
+        return;
+    }
+
+    // Wait for a worker still decoding it
+    std::lock_guard<std::mutex> busy(session->busy);
+    shm_unlink(session->name.c_str());
+    munmap(session->segment, session->segmentBytes);
+}
+
+void DecodeService712::Worker(int index)
+{
+    std::vector<std::shared_ptr<Session>> pass;
+
+    while(running) {
+        // Rings up to here are handled by this pass
+        uint64_t rings;
+        ssize_t ignored = read(doorbell, &rings, sizeof(rings));
+        (void)ignored;
+
+        {
+            std::lock_guard<std::mutex> lock(sessionsLock);
+            pass = sessions;
+        }
+
+        // Workers start at different sessions to spread the load
+        bool worked = false;
+        for(size_t i = 0; i < pass.size(); i++) {
+            Session &session = *pass[(i + index) % pass.size()];
+            // This worker may have taken the ring for input the holder already
+            //   looked past, so the holder passes again.
+            session.retry = true;
+            if(!session.busy.try_lock()) {
+                continue;
+            }
+            session.retry = false;
+            worked |= Service(session);
+            session.busy.unlock();
+            worked |= session.retry.exchange(false);
+        }
+        pass.clear();
+
+        if(!worked) {
+            pollfd fd = { doorbell, POLLIN, 0 };
+            poll(&fd, 1, IdleTimeoutMs);
+        }
+    }
+}
+
+bool DecodeService712::Service(Session &session)
+{
+    // A session may be closed (unmapped) while this pass held a reference to it
+    {
+        std::lock_guard<std::mutex> lock(sessionsLock);
+        if(std::find_if(sessions.begin(), sessions.end(), [&](const std::shared_ptr<Session> &open) {
+                return open.get() == &session; }) == sessions.end()) {
+            return false;
+        }
+    }
+    if(session.failed) {
+        return false;
+    }
+    // The client moves the output tail, a tail past head fails the session too.
+    if(session.output.Used() > session.output.Capacity()) {
+        session.failed = true;
+        Wake();
+        return false;
+    }
+
+    const BitVector pattern = session.decoder.GetPuncturePattern();
+    const uint32_t depth = session.decoder.GetTracebackDepth();
+
+    bool worked = false;
+    uint32_t decodedBits = 0;
+    uint32_t count;
+    BitVector input, output;
+    while(decodedBits < batchBits && session.input.Peek(count)) {
+        // The client writes the input ring, a record reaching past head (or a head
+        //   past the capacity) fails the session.
+        uint64_t used = session.input.Used();
+        if(used > session.input.Capacity() || DecodeRing712::RecordBytes(count) > used) {
+            session.failed = true;
+            Wake();
+            return worked;
+        }
+
+        if(session.frameMode) {
+            uint32_t outputBits = (uint64_t)count * pattern.Length() / pattern.Ones() / 2;
+            if(DecodeRing712::RecordBytes(outputBits) > session.output.Free()) {
+                break;
+            }
+
+            // Frames must be whole puncture periods, others get an empty record
+            //   to keep input and output records paired.
+            output.Clear();
+            if(count > 0 && (count % pattern.Ones()) == 0) {
+                input.Resize(count);
+                session.input.CopyOut(0, count, &input[0]);
+                output = session.decoder.DecodeTerminated(input);
+            }
+            session.input.Pop();
+            session.output.Write(output);
+            decodedBits += count;
+        } else {
+            // Streams may take part of a record, sized so the worst case output
+            //   fits in half of the ring.
+            uint32_t slice = std::min(count - session.recordOffset, batchBits - decodedBits);
+            slice = std::min(slice, (uint32_t)StreamSliceBits(pattern, session.output.Capacity()));
+            uint64_t maxOutput = ((uint64_t)slice / pattern.Ones() + 2) * pattern.Length() / 2 + depth;
+            if(DecodeRing712::RecordBytes(maxOutput) > session.output.Free()) {
+                break;
+            }
+
+            input.Resize(slice);
+            if(slice > 0) {
+                session.input.CopyOut(session.recordOffset, slice, &input[0]);
+            }
+            output = session.decoder.DecodeStream(input);
+            session.recordOffset += slice;
+            if(session.recordOffset == count) {
+                session.input.Pop();
+                session.recordOffset = 0;
+            }
+            if(output.Length() > 0) {
+                session.output.Write(output);
+            }
+            decodedBits += slice;
+        }
+        worked = true;
+    }
+
+    // Flush once everything written before FLUSH is decoded, the flushed bits
+    //   are at most the traceback depth.
+    if(session.flushPending && !session.input.Peek(count) &&
+            DecodeRing712::RecordBytes(depth) <= session.output.Free()) {
+        output = session.decoder.Flush();
+        if(output.Length() > 0) {
+            session.output.Write(output);
+        }
+        session.flushPending = false;
+        session.flushDone = true;
+        Wake();
+        worked = true;
+    }
+
+    return worked;
+}
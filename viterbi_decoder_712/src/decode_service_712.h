@@ -0,0 +1,230 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bit_vector.h"
+#include "viterbi_decoder_712.h"
+
+// Local decode service. Clients in any language connect to a UNIX stream socket,
+//   open a session and exchange data through a shared memory segment.
+//
+// Control protocol, one text line per request and reply:
+//   OPEN <stream|frame> <puncture pattern, e.g. 1110> <traceback depth> <ring bytes>
+//     -> OK <shared memory name>  or  ERR <reason>
+//     The OK line carries the service doorbell, an eventfd, as SCM_RIGHTS ancillary data.
+//   FLUSH -> OK, stream sessions only. Once all input written before it is decoded,
+//     the pending traceback depth is flushed (ViterbiDecoder712H::Flush) into an
+//     output record, then the reply is sent. The stream continues afterwards.
+//     Wait for the reply before the next request.
+//   CLOSE -> OK, the session also closes when the connection does.
+// One session per connection. The segment is unlinked when the session closes.
+// The traceback depth (plus the pattern length) must fit in a quarter of the ring.
+//
+// Segment layout: an input ring followed by an output ring, each a
+//   DecodeRingHeader712 followed by 'capacity' data bytes.
+// Rings carry records, a 32 bit native endian bit count followed by one byte per
+//   bit (the BitVector layout). Records may wrap around the end of the data.
+// The producer copies a record in, then advances head. The consumer reads it in
+//   place, then advances tail. Head and tail only increase, offset is value % capacity.
+// Stream sessions decode records with DecodeStream, so record boundaries are free.
+//   Frame sessions decode each record with DecodeTerminated, output is one record
+//   per input record, empty if the input is not whole puncture periods.
+// Input is only consumed once its worst case output fits in the output ring.
+// Idle workers sleep on the doorbell. Clients add to it (an 8 byte write) after writing
+//   input or reading output, clients that never ring are served within 10 ms.
+// The service never trusts the capacity in the headers after creating them.
+// A session whose input ring holds an inconsistent record, or whose output tail
+//   passes head, is closed.
+
+const uint32_t DecodeRingMagic712 = 0x56373132;
+const uint32_t DecodeRingVersion712 = 1;
+
+struct DecodeRingHeader712 {
+    uint32_t magic;
+    uint32_t version;
+    // Data bytes following the header, a power of two.
+    uint64_t capacity;
+    // Total bytes written by the producer
+    alignas(64) std::atomic<uint64_t> head;
+    // Total bytes read by the consumer
+    alignas(64) std::atomic<uint64_t> tail;
+};
+
+// Bytes of one ring in the segment, header and data.
+inline uint64_t DecodeRingBytes712(uint64_t capacity)
+{
+    return sizeof(DecodeRingHeader712) + capacity;
+}
+
+// Single producer single consumer view of a ring in a mapped segment.
+class DecodeRing712 {
+public:
+    DecodeRing712();
+    // Initializes a new ring at memory, DecodeRingBytes712(capacity) bytes.
+    void Create(void *memory, uint64_t capacity);
+    // Attaches to an existing ring of capacity bytes, false when the header does not match.
+    bool Attach(void *memory, uint64_t capacity);
+
+    // Appends a record, false when it does not fit right now.
+    bool Write(const uint8_t *bits, uint32_t count);
+    bool Write(const BitVector &bits);
+    // Bit count of the oldest record, false when the ring is empty.
+    bool Peek(uint32_t &count) const;
+    // Copies out the oldest record and consumes it.
+    bool Read(BitVector &bits);
+    // Copies bits [first, first + count) of the oldest record into bits[0, count).
+    void CopyOut(uint32_t first, uint32_t count, uint8_t *bits) const;
+    // Consumes the oldest record.
+    void Pop();
+
+    uint64_t Capacity() const;
+    // Bytes that can be written now, zero if the indices are inconsistent.
+    uint64_t Free() const;
+    // Bytes written and not yet consumed, as seen by the consumer.
+    // More than the capacity when the other side corrupted the indices.
+    uint64_t Used() const;
+    // Bytes a record of count bits takes.
+    static uint64_t RecordBytes(uint32_t count);
+
+private:
+    void CopyIn(uint64_t position, const void *source, uint64_t bytes);
+    void CopyOut(uint64_t position, void *destination, uint64_t bytes) const;
+
+    DecodeRingHeader712 *header;
+    uint8_t *data;
+    // Copied from Create or Attach, the other process can write the header.
+    uint64_t capacity;
+    uint64_t mask;
+};
+
+// Client side of the service, for C++ users and tests.
+class DecodeClient712 {
+public:
+    DecodeClient712();
+    ~DecodeClient712();
+
+    // Connects and opens a session, false on any failure.
+    bool Open(const std::string &socketPath, bool frameMode, const BitVector &pattern,
+              uint32_t depth, uint64_t ringBytes);
+    void Close();
+
+    // Submits encoded input, false when the input ring is full.
+    bool Write(const BitVector &input);
+    // Takes decoded output, false when none is ready.
+    bool Read(BitVector &output);
+    // Wakes the service workers, Write and Read ring it themselves.
+    void Ring();
+    // Flushes a stream session, appending every output record up to and including
+    //   the flushed bits to output. Blocks until done, false on failure.
+    bool Flush(BitVector &output);
+
+    DecodeRing712 &Input();
+    DecodeRing712 &Output();
+
+private:
+    int socket;
+    // Service doorbell received with the OPEN reply, -1 if none
+    int doorbell;
+    void *segment;
+    uint64_t segmentBytes;
+    DecodeRing712 input, output;
+};
+
+// The service. Sessions are decoded by a fixed set of worker threads, each pass
+//   decoding a batch of up to BatchBits input bits from every session with
+//   pending input.
+class DecodeService712 {
+public:
+    DecodeService712();
+    ~DecodeService712();
+
+    // Worker thread count, set before Run.
+    void SetWorkers(int count);
+    int GetWorkers() const;
+
+    // Input bits decoded per session per worker pass, set before Run.
+    void SetBatchBits(uint32_t bits);
+    uint32_t GetBatchBits() const;
+
+    // Listens on socketPath and serves until Stop, false if the socket can not be created.
+    bool Run(const std::string &socketPath);
+    // Safe to call from any thread or a signal handler.
+    void Stop();
+
+    // Open sessions
+    int Sessions() const;
+
+private:
+    struct Session {
+        int connection;
+        bool frameMode;
+        std::string name;
+        void *segment;
+        uint64_t segmentBytes;
+        DecodeRing712 input, output;
+        ViterbiDecoder712H decoder;
+        // Held by the worker decoding the session
+        std::mutex busy;
+        // Set by a worker that found the session busy, its holder passes again
+        std::atomic<bool> retry;
+        // Input record read so far
+        uint32_t recordOffset;
+        // FLUSH received, flushed by a worker once the input ring is empty
+        std::atomic<bool> flushPending;
+        // Flushed, the control thread sends the reply
+        std::atomic<bool> flushDone;
+        // A ring was corrupted, the control thread closes the session
+        std::atomic<bool> failed;
+    };
+
+    // Handles one control line, returns the reply.
+    // passDoorbell is set when the reply must carry the doorbell.
+    std::string Control(int connection, const std::string &line, bool &passDoorbell);
+    std::shared_ptr<Session> OpenSession(int connection, const std::vector<std::string> &args,
+                                         std::string &error);
+    void CloseSession(int connection);
+    void Worker(int index);
+    // Decodes up to BatchBits of pending input, true if any work was done.
+    bool Service(Session &session);
+    // Wakes the control thread, for replies and closes decided by a worker.
+    void Wake();
+    // Wakes idle workers.
+    void Ring();
+
+    int workers;
+    uint32_t batchBits;
+    std::atomic<bool> running;
+    int wakePipe[2];
+    // eventfd shared with every client, idle workers wait on it
+    int doorbell;
+
+    mutable std::mutex sessionsLock;
+    std::vector<std::shared_ptr<Session>> sessions;
+    uint64_t sessionCount;
+};
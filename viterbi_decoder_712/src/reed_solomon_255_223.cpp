@@ -0,0 +1,240 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "reed_solomon_255_223.h"
+
+#include <algorithm>
+#include <cstring>
+
+// x^8+x^7+x^2+x+1
+static const int FieldPolynomial = 0x187;
+// First consecutive root and root spacing, in log form
+static const int FirstRoot = 112;
+static const int RootSpacing = 11;
+// Log form of zero
+static const int LogZero = ReedSolomon255_223::N;
+
+ReedSolomon255_223::ReedSolomon255_223()
+{
+    int symbol = 1;
+    for(int i = 0; i < N; i++) {
+        alphaTo[i] = symbol;
+        indexOf[symbol] = i;
+        symbol <<= 1;
+        if(symbol & 0x100) {
+            symbol ^= FieldPolynomial;
+        }
+    }
+    alphaTo[LogZero] = 0;
+    indexOf[0] = LogZero;
+
+    // Product of (x + alpha^(RootSpacing * (FirstRoot + i)))
+    uint8_t poly[PARITY + 1] = { 1 };
+    for(int i = 0, root = FirstRoot * RootSpacing; i < PARITY; i++, root += RootSpacing) {
+        poly[i + 1] = 1;
+        for(int j = i; j > 0; j--) {
+            if(poly[j] != 0) {
+                poly[j] = poly[j - 1] ^ alphaTo[Modulo(indexOf[poly[j]] + root)];
+            } else {
+                poly[j] = poly[j - 1];
+            }
+        }
+        poly[0] = alphaTo[Modulo(indexOf[poly[0]] + root)];
+    }
+    for(int i = 0; i <= PARITY; i++) {
+        generator[i] = indexOf[poly[i]];
+    }
+
+    inversePrimitive = 1;
+    while((inversePrimitive % RootSpacing) != 0) {
+        inversePrimitive += N;
+    }
+    inversePrimitive /= RootSpacing;
+}
+
+int ReedSolomon255_223::Modulo(int x)
+{
+    while(x >= N) {
+        x -= N;
+        x = (x >> 8) + (x & N);
+    }
+    return x;
+}
+
+void ReedSolomon255_223::Encode(uint8_t codeword[N]) const
+{
+    // Systematic encoding with a shift register dividing by the generator
+    uint8_t *parity = &codeword[K];
+    memset(parity, 0, PARITY);
+
+    for(int i = 0; i < K; i++) {
+        int feedback = indexOf[codeword[i] ^ parity[0]];
+        if(feedback != LogZero) {
+            for(int j = 1; j < PARITY; j++) {
+                parity[j] ^= alphaTo[Modulo(feedback + generator[PARITY - j])];
+            }
+        }
+        memmove(&parity[0], &parity[1], PARITY - 1);
+        parity[PARITY - 1] = (feedback != LogZero) ? alphaTo[Modulo(feedback + generator[0])] : 0;
+    }
+}
+
+int ReedSolomon255_223::Decode(uint8_t codeword[N]) const
+{
+    // Syndromes, evaluating the codeword at each generator root
+    int syndrome[PARITY];
+    int errors = 0;
+    for(int i = 0; i < PARITY; i++) {
+        int s = codeword[0];
+        int root = Modulo((FirstRoot + i) * RootSpacing);
+        for(int j = 1; j < N; j++) {
+            s = codeword[j] ^ ((s == 0) ? 0 : alphaTo[Modulo(indexOf[s] + root)]);
+        }
+        errors |= s;
+        syndrome[i] = indexOf[s];
+    }
+    if(errors == 0) {
+        return 0;
+    }
+
+    // Berlekamp-Massey for the error locator lambda, b is the correction polynomial.
+    // lambda in polynomial form, b in log form.
+    int lambda[PARITY + 1] = { 1 };
+    int b[PARITY + 1];
+    for(int i = 0; i <= PARITY; i++) {
+        b[i] = indexOf[lambda[i]];
+    }
+
+    int degree = 0;
+    for(int r = 1; r <= PARITY; r++) {
+        int discrepancy = 0;
+        for(int i = 0; i < r; i++) {
+            if(lambda[i] != 0 && syndrome[r - i - 1] != LogZero) {
+                discrepancy ^= alphaTo[Modulo(indexOf[lambda[i]] + syndrome[r - i - 1])];
+            }
+        }
+        discrepancy = indexOf[discrepancy];
+
+        if(discrepancy == LogZero) {
+            memmove(&b[1], &b[0], PARITY * sizeof(int));
+            b[0] = LogZero;
+            continue;
+        }
+
+        int next[PARITY + 1];
+        next[0] = lambda[0];
+        for(int i = 0; i < PARITY; i++) {
+            next[i + 1] = lambda[i + 1] ^ ((b[i] != LogZero) ? alphaTo[Modulo(discrepancy + b[i])] : 0);
+        }
+        if(2 * degree <= r - 1) {
+            degree = r - degree;
+            for(int i = 0; i <= PARITY; i++) {
+                b[i] = (lambda[i] == 0) ? LogZero : Modulo(indexOf[lambda[i]] - discrepancy + N);
+            }
+        } else {
+            memmove(&b[1], &b[0], PARITY * sizeof(int));
+            b[0] = LogZero;
+        }
+        std::copy_n(next, PARITY + 1, lambda);
+    }
+
+    // Lambda to log form
+    int lambdaDegree = 0;
+    for(int i = 0; i <= PARITY; i++) {
+        lambda[i] = indexOf[lambda[i]];
+        if(lambda[i] != LogZero) {
+            lambdaDegree = i;
+        }
+    }
+    if(lambdaDegree != degree) {
+        return -1;
+    }
+
+    // Chien search for the roots of lambda, the error locations
+    int term[PARITY + 1];
+    std::copy_n(lambda, PARITY + 1, term);
+    int roots[PARITY], locations[PARITY];
+    int count = 0;
+    for(int i = 1, k = inversePrimitive - 1; i <= N; i++, k = Modulo(k + inversePrimitive)) {
+        int sum = 1;
+        for(int j = lambdaDegree; j > 0; j--) {
+            if(term[j] != LogZero) {
+                term[j] = Modulo(term[j] + j);
+                sum ^= alphaTo[term[j]];
+            }
+        }
+        if(sum != 0) {
+            continue;
+        }
+        roots[count] = i;
+        locations[count] = k;
+        if(++count == lambdaDegree) {
+            break;
+        }
+    }
+    if(count != lambdaDegree) {
+        return -1;
+    }
+
+    // Error evaluator omega = syndrome * lambda mod x^PARITY, in log form
+    int omega[PARITY];
+    int omegaDegree = lambdaDegree - 1;
+    for(int i = 0; i <= omegaDegree; i++) {
+        int sum = 0;
+        for(int j = i; j >= 0; j--) {
+            if(syndrome[i - j] != LogZero && lambda[j] != LogZero) {
+                sum ^= alphaTo[Modulo(syndrome[i - j] + lambda[j])];
+            }
+        }
+        omega[i] = indexOf[sum];
+    }
+
+    // Forney, error value = omega(X^-1) * X^(1-FirstRoot) / lambda'(X^-1).
+    // Values are computed for every location before any are applied.
+    uint8_t values[PARITY];
+    for(int j = 0; j < count; j++) {
+        int numerator = 0;
+        for(int i = omegaDegree; i >= 0; i--) {
+            if(omega[i] != LogZero) {
+                numerator ^= alphaTo[Modulo(omega[i] + i * roots[j])];
+            }
+        }
+        int scale = Modulo(roots[j] * (FirstRoot - 1) + N);
+
+        // Lambda' holds only the odd terms of lambda
+        int denominator = 0;
+        for(int i = std::min(lambdaDegree, PARITY - 1) & ~1; i >= 0; i -= 2) {
+            if(lambda[i + 1] != LogZero) {
+                denominator ^= alphaTo[Modulo(lambda[i + 1] + i * roots[j])];
+            }
+        }
+        if(denominator == 0) {
+            return -1;
+        }
+
+        values[j] = (numerator == 0) ? 0 :
+                alphaTo[Modulo(indexOf[numerator] + scale + N - indexOf[denominator])];
+    }
+
+    for(int j = 0; j < count; j++) {
+        codeword[locations[j]] ^= values[j];
+    }
+    return count;
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+// Reed-Solomon (255,223) code as used for the CCSDS outer code.
+// GF(256) with field polynomial x^8+x^7+x^2+x+1, generator roots
+//   alpha^(11*(112+i)) for i in [0,32), corrects up to 16 symbol errors.
+// Symbols are in the conventional (not dual) basis.
+// A codeword is 223 data bytes followed by 32 parity bytes.
+class ReedSolomon255_223 {
+public:
+    static const int N = 255;
+    static const int K = 223;
+    static const int PARITY = N - K;
+
+    ReedSolomon255_223();
+
+    // Fills codeword[K, N) with parity for the data in codeword[0, K).
+    void Encode(uint8_t codeword[N]) const;
+
+    // Corrects codeword in place.
+    // Returns the number of corrected symbols or -1 when uncorrectable,
+    //   an uncorrectable codeword is left unchanged.
+    int Decode(uint8_t codeword[N]) const;
+
+private:
+    // Reduces x to [0, N)
+    static int Modulo(int x);
+
+    // alpha^i for i in [0, N]
+    uint8_t alphaTo[N + 1];
+    // log_alpha of each symbol, N for zero
+    uint8_t indexOf[N + 1];
+    // Generator polynomial coefficients in log form
+    uint8_t generator[PARITY + 1];
+    // Inverse of the root spacing modulo N
+    int inversePrimitive;
+};
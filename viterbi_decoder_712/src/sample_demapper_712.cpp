@@ -0,0 +1,206 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "sample_demapper_712.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Samples demapped per Decode chunk before rounding to the puncture pattern.
+static const int DemapChunkBits = 4096;
+
+SampleDemapper712::SampleDemapper712()
+{
+    modulation = Modulation712::QPSK;
+    scale = 1.0f;
+    clip = 1.0f;
+    softBits = 1;
+}
+
+void SampleDemapper712::SetModulation(Modulation712 newModulation)
+{
+    modulation = newModulation;
+}
+
+Modulation712 SampleDemapper712::GetModulation() const
+{
+    return modulation;
+}
+
+void SampleDemapper712::SetScale(float newScale)
+{
+    scale = newScale;
+}
+
+float SampleDemapper712::GetScale() const
+{
+    return scale;
+}
+
+void SampleDemapper712::SetClip(float newClip)
+{
+    assert(newClip > 0.0f);
+    clip = newClip;
+}
+
+float SampleDemapper712::GetClip() const
+{
+    return clip;
+}
+
+void SampleDemapper712::SetSoftBits(int bits)
+{
+    assert(bits >= 1 && bits <= 8);
+    softBits = bits;
+}
+
+int SampleDemapper712::GetSoftBits() const
+{
+    return softBits;
+}
+
+int SampleDemapper712::BitsPerSample() const
+{
+    return (modulation == Modulation712::QPSK) ? 2 : 1;
+}
+
+int SampleDemapper712::Demap(const float *samples, int count, uint8_t *out) const
+{
+    return DemapSamples(samples, count, softBits, out);
+}
+
+int SampleDemapper712::Demap(const int16_t *samples, int count, uint8_t *out) const
+{
+    return DemapSamples(samples, count, softBits, out);
+}
+
+BitVector SampleDemapper712::Decode(ViterbiDecoder712H &decoder, const float *samples, int count)
+{
+    return DecodeSamples(decoder, samples, count);
+}
+
+BitVector SampleDemapper712::Decode(ViterbiDecoder712H &decoder, const int16_t *samples, int count)
+{
+    return DecodeSamples(decoder, samples, count);
+}
+
+#if defined(__SSE2__)
+// Four components as floats, consecutive (stride 1) or every other one (stride 2).
+static inline __m128 LoadComponents(const float *p, int stride)
+{
+    if(stride == 1) {
+        return _mm_loadu_ps(p);
+    }
+    return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4), _MM_SHUFFLE(2, 0, 2, 0));
+}
+
+static inline __m128 LoadComponents(const int16_t *p, int stride)
+{
+    __m128i x;
+    if(stride == 1) {
+        // Sign extend the low 4 int16 values
+        x = _mm_loadl_epi64((const __m128i *)p);
+        x = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+    } else {
+        // The low half of each 32 bit lane is I
+        x = _mm_loadu_si128((const __m128i *)p);
+        x = _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+    }
+    return _mm_cvtepi32_ps(x);
+}
+#endif
+
+// Scale, clip and quantize, a separate loop per stride so each one is a plain
+//   vector loop. Uses SSE2 where available, four values per step.
+template<int stride, class T>
+static void DemapComponents(const T *samples, int values, float gain, float offset,
+                            float maxLevel, uint8_t *out)
+{
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 g = _mm_set1_ps(gain);
+    const __m128 o = _mm_set1_ps(offset);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 top = _mm_set1_ps(maxLevel);
+    for(; i + 4 <= values; i += 4) {
+        __m128 x = _mm_add_ps(_mm_mul_ps(LoadComponents(&samples[i * stride], stride), g), o);
+        x = _mm_min_ps(_mm_max_ps(x, zero), top);
+        __m128i q = _mm_cvttps_epi32(x);
+        q = _mm_packs_epi32(q, q);
+        q = _mm_packus_epi16(q, q);
+        uint32_t packed = _mm_cvtsi128_si32(q);
+        memcpy(&out[i], &packed, 4);
+    }
+#endif
+    for(; i < values; i++) {
+        float x = (float)samples[i * stride] * gain + offset;
+        x = std::min(std::max(x, 0.0f), maxLevel);
+        out[i] = (uint8_t)x;
+    }
+}
+
+// BPSK reads every other component (I only), QPSK reads all components.
+template<class T>
+int SampleDemapper712::DemapSamples(const T *samples, int count, int bits, uint8_t *out) const
+{
+    assert(samples && out);
+
+    const int values = count * BitsPerSample();
+
+    // Map [-clip, clip] linearly onto [levels, 0] so positive amplitudes become zeros.
+    const float levels = (float)(1 << bits);
+    const float gain = -scale * levels / (2.0f * clip);
+    const float offset = levels / 2.0f;
+    const float maxLevel = levels - 1.0f;
+
+    if(modulation == Modulation712::QPSK) {
+        DemapComponents<1>(samples, values, gain, offset, maxLevel, out);
+    } else {
+        DemapComponents<2>(samples, values, gain, offset, maxLevel, out);
+    }
+
+    return values;
+}
+
+template<class T>
+BitVector SampleDemapper712::DecodeSamples(ViterbiDecoder712H &decoder, const T *samples, int count)
+{
+    const int ones = decoder.GetPuncturePattern().Ones();
+    const int bitsPerSample = BitsPerSample();
+    const int componentsPerSample = 2;
+    assert(((count * bitsPerSample) % ones) == 0);
+
+    // Chunk must end on both a sample and a puncture pattern boundary
+    int chunkSamples = std::max(1, DemapChunkBits / (ones * bitsPerSample)) * ones;
+
+    BitVector decoded;
+    for(int pos = 0; pos < count; pos += chunkSamples) {
+        int n = std::min(chunkSamples, count - pos);
+        chunk.Resize(n * bitsPerSample);
+        DemapSamples(samples + pos * componentsPerSample, n, 1, &chunk[0]);
+        decoded += decoder.Decode(chunk);
+    }
+
+    return decoded;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+
+#include "bit_vector.h"
+#include "viterbi_decoder_712.h"
+
+enum class Modulation712 {
+    // One bit per complex sample, taken from I. Q is ignored.
+    BPSK,
+    // Two bits per complex sample, I then Q.
+    QPSK
+};
+
+// Converts float or int16 I/Q samples into decoder input.
+// Input buffers are interleaved I/Q pairs, count is the number of complex samples.
+// Bit 0 maps to a positive amplitude, bit 1 to a negative amplitude.
+// Each component is multiplied by the scale, clipped to [-clip, clip] and
+//   quantized to softBits offset binary levels, 0 being a confident zero and
+//   (1 << softBits) - 1 a confident one. With softBits == 1 the output is hard bits.
+// Output is one value per byte, the layout BitVector and the decoder use.
+class SampleDemapper712 {
+public:
+    SampleDemapper712();
+
+    void SetModulation(Modulation712 newModulation);
+    Modulation712 GetModulation() const;
+
+    void SetScale(float newScale);
+    float GetScale() const;
+
+    // Clip level applied after scaling, must be positive.
+    void SetClip(float newClip);
+    float GetClip() const;
+
+    // Quantization bits per output value, [1,8].
+    void SetSoftBits(int bits);
+    int GetSoftBits() const;
+
+    // Number of output values produced per complex sample.
+    int BitsPerSample() const;
+
+    // Demaps count complex samples into out.
+    // out must hold count * BitsPerSample() values. Returns the number written.
+    int Demap(const float *samples, int count, uint8_t *out) const;
+    int Demap(const int16_t *samples, int count, uint8_t *out) const;
+
+    // Hard demaps and decodes count complex samples through decoder.Decode,
+    //   one chunk at a time, so no full frame bit vector is created.
+    // count * BitsPerSample() must be a multiple of the decoder puncture pattern ones.
+    BitVector Decode(ViterbiDecoder712H &decoder, const float *samples, int count);
+    BitVector Decode(ViterbiDecoder712H &decoder, const int16_t *samples, int count);
+
+private:
+    template<class T>
+    int DemapSamples(const T *samples, int count, int bits, uint8_t *out) const;
+    template<class T>
+    BitVector DecodeSamples(ViterbiDecoder712H &decoder, const T *samples, int count);
+
+    Modulation712 modulation;
+    float scale;
+    float clip;
+    int softBits;
+    // Reused decoder input for each chunk
+    BitVector chunk;
+};
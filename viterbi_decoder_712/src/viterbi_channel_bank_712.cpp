@@ -0,0 +1,223 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#include "viterbi_channel_bank_712.h"
+
+#include <algorithm>
+
+// Start metric of every non-zero state. Any value larger than the
+//   12 a path can accumulate over the 6 stages needed to reach all states
+//   behaves the same as the infinite start metric.
+static const uint16_t StartMetric = 0x1000;
+// Metrics are rebased once the best metric passes this value.
+static const uint16_t RenormalizeMetric = 0x8000;
+
+ViterbiChannelBank712::ViterbiChannelBank712(int channelCount)
+{
+    assert(channelCount > 0);
+    channels = channelCount;
+    puncturePattern = PuncturePattern712_12;
+    tracebackDepth = Traceback712_12;
+    Reset();
+}
+
+void ViterbiChannelBank712::SetTracebackDepth(uint32_t depth)
+{
+    assert(depth > 0 && depth < 0xFFFF);
+    tracebackDepth = depth;
+    Reset();
+}
+
+uint32_t ViterbiChannelBank712::GetTracebackDepth() const
+{
+    return tracebackDepth;
+}
+
+void ViterbiChannelBank712::SetPuncturePattern(const BitVector &pattern)
+{
+    puncturePattern = pattern;
+
+    if(puncturePattern.Size() == 0) {
+        puncturePattern = PuncturePattern712_12;
+    }
+
+    assert((puncturePattern.Size() % N) == 0);
+    Reset();
+}
+
+BitVector ViterbiChannelBank712::GetPuncturePattern() const
+{
+    return puncturePattern;
+}
+
+int ViterbiChannelBank712::Channels() const
+{
+    return channels;
+}
+
+int ViterbiChannelBank712::BytesPerChannel() const
+{
+    return STATES * sizeof(uint16_t) + columns * sizeof(uint64_t) + sizeof(uint16_t);
+}
+
+BitVector ViterbiChannelBank712::Decode(int channel, const BitVector &input)
+{
+    assert(channel >= 0 && channel < channels);
+    assert(input.Length() % puncturePattern.Ones() == 0);
+
+    const int stages = (input.Length() / puncturePattern.Ones()) * (puncturePattern.Length() / N);
+
+    BitVector decoded;
+    decoded.Resize(stages);
+
+    // Work on local copies of the path metrics, swapped each stage.
+    uint16_t metricBuf[2][STATES];
+    uint16_t *prevMetric = metricBuf[0];
+    uint16_t *currMetric = metricBuf[1];
+    std::copy_n(&metrics[channel * STATES], STATES, prevMetric);
+
+    uint64_t *d = &decisions[channel * columns];
+    int pos = decisionPos[channel];
+
+    int srcIndex = 0;
+    int punctureIndex = 0;
+
+    for(int i = 0; i < stages; i++) {
+        // Received bits, punctured bits are ignored through the mask.
+        uint8_t p[2], s[2];
+        for(int k = 0; k < 2; k++) {
+            p[k] = puncturePattern[punctureIndex + k];
+            s[k] = p[k] ? input[srcIndex++] : 0;
+        }
+        punctureIndex += 2;
+        if(punctureIndex >= puncturePattern.Size()) {
+            punctureIndex = 0;
+        }
+
+        uint16_t bm[4];
+        for(int code = 0; code < 4; code++) {
+            bm[code] = ((s[0] ^ (code >> 1)) & p[0]) + ((s[1] ^ (code & 1)) & p[1]);
+        }
+
+        // Same butterfly and tie breaking as ViterbiDecoder712H.
+        uint64_t column = 0;
+        for(uint32_t state = 0; state < 32; state++) {
+            uint32_t code = (ButterflyCodes712 >> (2 * state)) & 3;
+            uint16_t m0 = bm[code];
+            uint16_t m1 = bm[code ^ 3];
+
+            uint16_t fm0 = prevMetric[state] + m0;
+            uint16_t fm1 = prevMetric[state+32] + m1;
+            uint64_t p1 = (fm0 <= fm1) ? 0 : 1;
+            currMetric[state*2] = p1 ? fm1 : fm0;
+
+            fm0 = prevMetric[state] + m1;
+            fm1 = prevMetric[state+32] + m0;
+            uint64_t p2 = (fm0 <= fm1) ? 0 : 1;
+            currMetric[state*2+1] = p2 ? fm1 : fm0;
+
+            column |= (p1 << (state*2)) | (p2 << (state*2 + 1));
+        }
+        d[pos] = column;
+
+        uint32_t bestState = 0;
+        uint16_t bestMetric = currMetric[0];
+        for(uint32_t state = 1; state < STATES; state++) {
+            if(currMetric[state] < bestMetric) {
+                bestMetric = currMetric[state];
+                bestState = state;
+            }
+        }
+
+        // Keep metrics inside 16 bits.
+        if(bestMetric >= RenormalizeMetric) {
+            for(uint32_t state = 0; state < STATES; state++) {
+                currMetric[state] -= bestMetric;
+            }
+        }
+
+        int pathPos = pos;
+        uint32_t cState = bestState;
+        for(int j = 0; j < columns - 1; j++) {
+            cState = (cState >> 1) | (((d[pathPos] >> cState) & 1) << 5);
+
+            pathPos--;
+            if(pathPos < 0) {
+                pathPos = columns - 1;
+            }
+        }
+
+        decoded[i] = cState & 0x1;
+
+        pos++;
+        if(pos >= columns) {
+            pos = 0;
+        }
+
+        uint16_t *tmp = prevMetric;
+        prevMetric = currMetric;
+        currMetric = tmp;
+    }
+
+    std::copy_n(prevMetric, STATES, &metrics[channel * STATES]);
+    decisionPos[channel] = pos;
+
+    return decoded;
+}
+
+void ViterbiChannelBank712::DecodeBatch(std::vector<ChannelJob712> &jobs)
+{
+    // Stable so jobs for the same channel decode in the order given
+    std::stable_sort(jobs.begin(), jobs.end(), [](const ChannelJob712 &a, const ChannelJob712 &b) {
+        return a.channel < b.channel;
+    });
+
+    for(ChannelJob712 &job : jobs) {
+        assert(job.input);
+        job.output = Decode(job.channel, *job.input);
+    }
+}
+
+void ViterbiChannelBank712::Reset()
+{
+    columns = tracebackDepth + 1;
+    metrics.resize(channels * STATES);
+    decisions.resize(channels * columns);
+    decisionPos.resize(channels);
+
+    for(int i = 0; i < channels; i++) {
+        Reset(i);
+    }
+}
+
+void ViterbiChannelBank712::Reset(int channel)
+{
+    assert(channel >= 0 && channel < channels);
+
+    uint16_t *m = &metrics[channel * STATES];
+    for(uint32_t i = 0; i < STATES; i++) {
+        m[i] = StartMetric;
+    }
+    // This forces the zero starting state.
+    m[0] = 0;
+
+    std::fill_n(&decisions[channel * columns], columns, 0);
+    decisionPos[channel] = 1;
+}
@@ -0,0 +1,89 @@
+// Copyright (c) 2020 Andrew Montgomery
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "bit_vector.h"
+#include "convolutional_encoder_712.h"
+
+// One unit of work for ViterbiChannelBank712::DecodeBatch.
+struct ChannelJob712 {
+    int channel;
+    const BitVector *input;
+    BitVector output;
+};
+
+// Continuous hard decision Viterbi decoding of many independent channels
+//   sharing one puncture pattern and traceback depth.
+// Output matches ViterbiDecoder712H::Decode for each channel.
+// Trellis outputs come from the compile time ButterflyCodes712 table and the puncture
+//   pattern is stored once, so each channel only holds its path metrics and decisions.
+// Channel state is kept in flat structure-of-arrays storage indexed by channel.
+class ViterbiChannelBank712 {
+    static const uint32_t N = 2;
+    static const uint32_t STATES = 64;
+
+public:
+    explicit ViterbiChannelBank712(int channelCount);
+
+    // Setting a new traceback depth resets all channels.
+    void SetTracebackDepth(uint32_t depth);
+    uint32_t GetTracebackDepth() const;
+
+    // Setting a new puncture pattern resets all channels.
+    void SetPuncturePattern(const BitVector &pattern);
+    BitVector GetPuncturePattern() const;
+
+    int Channels() const;
+    // Bytes of state held per channel
+    int BytesPerChannel() const;
+
+    // Input is encoded and punctured bit vector for one channel.
+    // Depunctured input length must be multiple of the puncture pattern length.
+    BitVector Decode(int channel, const BitVector &input);
+
+    // Decodes every job, visiting channels in storage order.
+    // Jobs are sorted by channel. Jobs for the same channel decode in the order
+    //   given, as consecutive parts of its stream.
+    void DecodeBatch(std::vector<ChannelJob712> &jobs);
+
+    // Resets all channels or a single channel.
+    void Reset();
+    void Reset(int channel);
+
+private:
+    int channels;
+    BitVector puncturePattern;
+    uint32_t tracebackDepth;
+    // Decision columns per channel, tracebackDepth + 1
+    int columns;
+
+    // Per channel storage
+    // Path metrics, STATES per channel, renormalized to fit 16 bits.
+    std::vector<uint16_t> metrics;
+    // Decision columns, one word per column. Bit s is set when state s
+    //   was reached from (s >> 1) + 32 rather than (s >> 1).
+    std::vector<uint64_t> decisions;
+    // Current position in each channel's decision columns
+    std::vector<uint16_t> decisionPos;
+};
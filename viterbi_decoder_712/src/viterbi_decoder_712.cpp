@@ -20,21 +20,63 @@
 
 #include "viterbi_decoder_712.h"
 
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <limits>
 
+// Two bit code of an output pair, first output in the high bit.
+static uint8_t OutputCode(const uint8_t outputs[2])
+{
+    return (outputs[0] << 1) | outputs[1];
+}
+
 ViterbiDecoder712H::ViterbiDecoder712H()
 {
     puncturePattern = PuncturePattern712_12;
     tracebackDepth = Traceback712_12;
+    radix = 2;
+    engine = SurvivorEngine712::Traceback;
+    reducedStates = STATES;
+    reducedThreshold = 0;
     decisionPos = 0;
     prevMetric = nullptr;
     currMetric = nullptr;
+    prevSurvivor = nullptr;
+    currSurvivor = nullptr;
+    linkWindowBits = 10000;
+    linkLockThreshold = 0.02;
+    linkLastMetric = 0;
+    ResetLinkQuality();
+
+    // Precombine the outputs of the two stages traversed by each radix 4 transition.
+    for(uint32_t state = 0; state < STATES; state++) {
+        for(int d = 0; d < 4; d++) {
+            uint32_t prev = (state >> 2) | (d << 4);
+            uint32_t b1 = (state >> 1) & 1;
+            uint32_t b2 = state & 1;
+            uint32_t mid = trellis.nextState[prev][b1];
+            assert(trellis.nextState[mid][b2] == state);
+
+            radix4Codes[state][d] = (OutputCode(trellis.outputs[prev][b1]) << 2) |
+                    OutputCode(trellis.outputs[mid][b2]);
+        }
+    }
+
+    Reset();
 }
 
+// Time of a traceback path entry that was never recorded
+static const int64_t NoPathTime = std::numeric_limits<int64_t>::min();
+
+// Deepest traceback a 64 bit survivor register can hold, leaving room
+//   for the two inputs added by a radix 4 step.
+static const int RegisterExchangeMaxDepth = 62;
+
 void ViterbiDecoder712H::SetTracebackDepth(uint32_t depth)
 {
     assert(depth > 0);
+    assert(engine != SurvivorEngine712::RegisterExchange || depth <= RegisterExchangeMaxDepth);
     tracebackDepth = depth;
     Reset();
 }
@@ -60,47 +102,350 @@ BitVector ViterbiDecoder712H::GetPuncturePattern() const
     return puncturePattern;
 }
 
+void ViterbiDecoder712H::SetRadix(uint32_t newRadix)
+{
+    assert(newRadix == 2 || newRadix == 4);
+    assert(newRadix == 2 || reducedStates == STATES);
+    radix = newRadix;
+    Reset();
+}
+
+uint32_t ViterbiDecoder712H::GetRadix() const
+{
+    return radix;
+}
+
+void ViterbiDecoder712H::SetReducedState(uint32_t maxStates, uint32_t threshold)
+{
+    assert(maxStates > 0 && maxStates <= STATES);
+    assert((maxStates == STATES && threshold == 0) ||
+           (radix == 2 && engine == SurvivorEngine712::RegisterExchange));
+    reducedStates = maxStates;
+    reducedThreshold = threshold;
+    Reset();
+}
+
+uint32_t ViterbiDecoder712H::GetReducedStateCount() const
+{
+    return reducedStates;
+}
+
+uint32_t ViterbiDecoder712H::GetReducedStateThreshold() const
+{
+    return reducedThreshold;
+}
+
+void ViterbiDecoder712H::SetSurvivorEngine(SurvivorEngine712 newEngine)
+{
+    assert(newEngine != SurvivorEngine712::RegisterExchange ||
+           tracebackDepth <= RegisterExchangeMaxDepth);
+    assert(newEngine == SurvivorEngine712::RegisterExchange ||
+           (reducedStates == STATES && reducedThreshold == 0));
+    engine = newEngine;
+    Reset();
+}
+
+SurvivorEngine712 ViterbiDecoder712H::GetSurvivorEngine() const
+{
+    return engine;
+}
+
+void ViterbiDecoder712H::SchedulePuncturePattern(const BitVector &pattern, uint32_t depth, int64_t stage)
+{
+    // Period boundary of the pattern that will be in use just before the switch
+    const BitVector &before = schedule.empty() ? puncturePattern : schedule.back().pattern;
+    assert(stage >= lastPatternStage && stage >= GetStage());
+    assert(((stage - lastPatternStage) % (before.Size() / N)) == 0);
+
+    ScheduledPattern next;
+    next.stage = stage;
+    next.pattern = (pattern.Size() == 0) ? PuncturePattern712_12 : pattern;
+    next.depth = depth;
+    assert((next.pattern.Size() % N) == 0);
+    assert(engine != SurvivorEngine712::RegisterExchange || (int)depth <= RegisterExchangeMaxDepth);
+    schedule.push_back(next);
+    lastPatternStage = stage;
+
+    // Size the decision history now so the switch itself never allocates.
+    ReserveDepth(depth);
+}
+
+int64_t ViterbiDecoder712H::GetStage() const
+{
+    // Stages held by DecodeStream were already depunctured with the current pattern.
+    return trellisTime + (heldCount + N - 1) / N;
+}
+
 BitVector ViterbiDecoder712H::Decode(const BitVector &input)
 {
-    assert(input.Length() % puncturePattern.Ones() == 0);
+    return DecodeInput(input, 0, tracebackDepth, false);
+}
 
-    // Perform depuncturing up front
-    // Create new array where we insert the punctured data with a zero
-    // Later on, the HammingDistanceViterbi function will ignore this bit.
-    BitVector depunctured;
+BitVector ViterbiDecoder712H::DecodeWithLatency(const BitVector &input, uint32_t latency)
+{
+    return DecodeInput(input, 0, latency, false);
+}
+
+BitVector ViterbiDecoder712H::DecodeStream(const BitVector &input)
+{
+    return DecodeInput(input, 0, tracebackDepth, true);
+}
+
+BitVector ViterbiDecoder712H::Flush()
+{
+    return DecodeInput(BitVector(), 0, 0, true);
+}
+
+BitVector ViterbiDecoder712H::DecodeInput(const BitVector &input, int tailBits, uint32_t latency, bool stream)
+{
+    BitVector decoded;
+    int outCount = 0;
+    const int startHeldChannelBits = heldChannelBits;
+
+    // How many input decoded bits are in the message
+    int iters = Depuncture(input, tailBits, stream);
+    // At most every input not yet returned, the pending bits plus one per stage
+    decoded.Resize(trellisTime + iters - nextOutput);
+
+    // Depth changes take effect at their stage, radix 4 at the step containing it.
+    int done = 0;
+    size_t applied = 0;
+    for(; applied < depthChanges.size(); applied++) {
+        int stage = depthChanges[applied].first;
+        int split = (radix == 4) ? (stage + (stage & 1)) : stage;
+        if(split > iters) {
+            break;
+        }
+        DecodeStages(done, split - done, decoded, outCount);
+        done = split;
+        tracebackDepth = depthChanges[applied].second;
+    }
+    DecodeStages(done, iters - done, decoded, outCount);
+
+    // Changes inside the held stages apply during the next call
+    depthChanges.erase(depthChanges.begin(), depthChanges.begin() + applied);
+    for(std::pair<int, int> &change : depthChanges) {
+        change.first -= iters;
+    }
+
+    // Never hold bits longer than the (possibly switched) traceback depth.
+    // Streams leave that to their next step so the output does not depend on
+    //   where the buffers end, only Flush emits early.
+    if(!stream || latency == 0) {
+        Emit(trellisTime - 1 - (int)std::min<uint32_t>(latency, tracebackDepth), decoded, outCount);
+    }
+    // The zero tail was never received, it does not count as channel bits
+    UpdateLinkQuality(input.Length() + startHeldChannelBits - heldChannelBits, iters);
+
+    decoded.Resize(outCount);
+    return decoded;
+}
+
+BitVector ViterbiDecoder712H::DecodeTerminated(const BitVector &input)
+{
+    assert(input.Size() % puncturePattern.Ones() == 0);
+    uint32_t returnSize = ((input.Size() * puncturePattern.Size()) / puncturePattern.Ones()) / 2;
+
+    // Reset trellis before and after a terminated decode
+    Reset();
+
+    // Append enough zeros to satisfy the puncture pattern ratio and flush the full traceback.
+    int zerosToPad = ceil((double)(tracebackDepth * N) / puncturePattern.Ones())
+            * puncturePattern.Ones();
+
+    // Radix 4 consumes stages in pairs, pad one more period if the total is odd.
+    int periodStages = puncturePattern.Size() / N;
+    int totalStages = returnSize + (zerosToPad / puncturePattern.Ones()) * periodStages;
+    if(radix == 4 && (totalStages % 2) != 0) {
+        zerosToPad += puncturePattern.Ones();
+    }
+
+    // The known start state needs no leading traceback, output begins at stage 0
+    nextOutput = 0;
+    BitVector decoded = DecodeInput(input, zerosToPad, tracebackDepth, false);
 
-    // Number of times we will iterate through the puncture pattern
-    int iter = input.Length() / puncturePattern.Ones();
-    depunctured.Resize(iter * puncturePattern.Length());
+    // Reset trellis before and after a terminated decode
+    Reset();
+
+    // Drop the decoded tail in place
+    decoded.Resize(returnSize);
+    return decoded;
+}
+
+uint8_t ViterbiDecoder712H::HD(const uint8_t a[2], const uint8_t b[2], const uint8_t p[2])
+{
+    return ((a[0] ^ b[0]) & p[0]) + ((a[1] ^ b[1]) & p[1]);
+}
+
+int ViterbiDecoder712H::Depuncture(const BitVector &input, int tailBits, bool stream)
+{
+    // Perform depuncturing up front
+    // Insert the punctured data with a zero and a zero flag in the mask.
+    // Later on, the Hamming distance will ignore this bit.
+
+    // Size for the longest depunctured period per fewest received bits of any
+    //   pattern the input may use, plus the partial periods at either end.
+    // Trimmed to the actual length at the end.
+    int maxLength = puncturePattern.Length();
+    int minOnes = puncturePattern.Ones();
+    for(const ScheduledPattern &next : schedule) {
+        maxLength = std::max(maxLength, next.pattern.Length());
+        minOnes = std::min(minOnes, next.pattern.Ones());
+    }
+    const int sourceBits = input.Length() + tailBits;
+    depunctured.Resize((sourceBits / minOnes + 2) * maxLength + heldCount);
+    depuncturedMask.Resize(depunctured.Length());
+
+    // Bits held by the previous stream call come first
+    int dstIndex = 0;
+    for(; dstIndex < heldCount; dstIndex++) {
+        depunctured[dstIndex] = heldBits[dstIndex];
+        depuncturedMask[dstIndex] = heldMask[dstIndex];
+    }
 
     int srcIndex = 0;
-    for(int i = 0; i < iter; i++) {
-        for(int j = 0; j < puncturePattern.Length(); j++) {
-            if(puncturePattern[j] == 1) {
-                depunctured[i*puncturePattern.Length() + j] = input[srcIndex++];
+    for(;;) {
+        // Switch patterns at the start of the period they are scheduled for.
+        // A switch at the end of the input is applied now, so GetPuncturePattern reflects it.
+        int64_t stage = trellisTime + dstIndex / N;
+        while(punctureIx == 0 && !schedule.empty() && schedule.front().stage == stage) {
+            puncturePattern = schedule.front().pattern;
+            if(schedule.front().depth > 0) {
+                depthChanges.push_back(std::make_pair(dstIndex / N, schedule.front().depth));
+            }
+            schedule.pop_front();
+        }
+
+        if(srcIndex >= sourceBits) {
+            break;
+        }
+
+        // Input must complete the puncture period unless streaming.
+        assert(stream || sourceBits - srcIndex >= puncturePattern.Ones());
+        assert(punctureIx != 0 || schedule.empty() || schedule.front().stage > stage);
+
+        // Resumes a period held by the previous stream call, stops at the first
+        //   received bit past the end of the input.
+        for(; punctureIx < puncturePattern.Length(); punctureIx++) {
+            if(puncturePattern[punctureIx] == 1) {
+                if(srcIndex >= sourceBits) {
+                    break;
+                }
+                depunctured[dstIndex] = (srcIndex < input.Length()) ? input[srcIndex] : 0;
+                srcIndex++;
             } else {
                 // Set any punctured values to zero, doesn't matter value is used
-                depunctured[i*puncturePattern.Length() + j] = 0;
+                depunctured[dstIndex] = 0;
             }
+            depuncturedMask[dstIndex++] = puncturePattern[punctureIx];
+        }
+        if(punctureIx < puncturePattern.Length()) {
+            break;
         }
+        punctureIx = 0;
     }
 
-    assert((depunctured.Length() % N) == 0);
+    // Radix 4 decodes stages in pairs
+    int stages = dstIndex / N;
+    if(radix == 4) {
+        stages &= ~1;
+    }
+    assert(stream || (punctureIx == 0 && stages * (int)N == dstIndex));
+
+    heldCount = dstIndex - stages * N;
+    heldChannelBits = 0;
+    for(int i = 0; i < heldCount; i++) {
+        heldBits[i] = depunctured[stages * N + i];
+        heldMask[i] = depuncturedMask[stages * N + i];
+        heldChannelBits += heldMask[i];
+    }
 
-    // How many input decoded bits are in the message
-    int iters = depunctured.Size() / N;
+    depunctured.Resize(stages * N);
+    depuncturedMask.Resize(stages * N);
 
-    BitVector decoded;
-    decoded.Resize(iters);
+    return stages;
+}
 
-    // Pointer to depunctured bits
-    const uint8_t *s = &depunctured[0];
-    int punctureIndex = 0;
+void ViterbiDecoder712H::ReserveDepth(int depth)
+{
+    if(engine == SurvivorEngine712::RegisterExchange) {
+        return;
+    }
+
+    int trellisDepth = (radix == 4) ? (depth / 2 + 1) : (depth + 1);
+    int extra = trellisDepth - (int)decisions.size();
+    if(extra <= 0) {
+        return;
+    }
+
+    // New columns go in front of the oldest column, where the next decisions
+    //   are written, so the existing history keeps its order.
+    decisions.insert(decisions.begin() + decisionPos, extra, std::vector<uint8_t>(STATES, 0));
+    pathStates.insert(pathStates.begin() + decisionPos, extra, 0);
+    pathTimes.insert(pathTimes.begin() + decisionPos, extra, NoPathTime);
+}
+
+void ViterbiDecoder712H::BranchMetrics(const uint8_t *s, const uint8_t *p, uint32_t m[4])
+{
+    for(int code = 0; code < 4; code++) {
+        const uint8_t bits[2] = { (uint8_t)(code >> 1), (uint8_t)(code & 1) };
+        m[code] = HD(s, bits, p);
+    }
+}
+
+uint32_t ViterbiDecoder712H::BestState(const uint32_t *metric) const
+{
+    // Best metric from independent partial minimums, then the lowest state holding it.
+    uint32_t m[4] = { metric[0], metric[1], metric[2], metric[3] };
+    for(uint32_t i = 4; i < STATES; i += 4) {
+        for(int j = 0; j < 4; j++) {
+            m[j] = std::min(m[j], metric[i + j]);
+        }
+    }
+    uint32_t bestHamming = std::min(std::min(m[0], m[1]), std::min(m[2], m[3]));
+
+    uint32_t bestFinalState = 0;
+    while(metric[bestFinalState] != bestHamming) {
+        bestFinalState++;
+    }
+    return bestFinalState;
+}
+
+void ViterbiDecoder712H::DecodeStages(int first, int stages, BitVector &decoded, int &outCount)
+{
+    if(stages <= 0) {
+        return;
+    }
+
+    bool exchange = (engine == SurvivorEngine712::RegisterExchange);
+    if(reducedStates < STATES || reducedThreshold > 0) {
+        DecodeReduced(first, stages, decoded, outCount);
+    } else if(radix == 4) {
+        if(exchange) {
+            DecodeRadix4<true>(first, stages, decoded, outCount);
+        } else {
+            DecodeRadix4<false>(first, stages, decoded, outCount);
+        }
+    } else {
+        if(exchange) {
+            DecodeRadix2<true>(first, stages, decoded, outCount);
+        } else {
+            DecodeRadix2<false>(first, stages, decoded, outCount);
+        }
+    }
+}
+
+template<bool exchange>
+void ViterbiDecoder712H::DecodeRadix2(int first, int stages, BitVector &decoded, int &outCount)
+{
+    // Pointer to depunctured bits and their puncture flags
+    const uint8_t *s = &depunctured[first * N];
+    const uint8_t *p = &depuncturedMask[first * N];
 
     // Go through each trellis column
-    for(int i = 0; i < iters; i++) {
+    for(int i = 0; i < stages; i++) {
         // Pointer to decision column
-        uint8_t *d = &decisions[decisionPos][0];
+        uint8_t *d = exchange ? nullptr : &decisions[decisionPos][0];
 
         // For each state transition find the potential previous states
         // Calculate the min hamming distance for all transitions into a state
@@ -112,130 +457,464 @@ BitVector ViterbiDecoder712H::Decode(const BitVector &input)
             // Calculate metrics of new coded bits without and with current full path metrics.
             uint32_t m[2], fm[2];
 
-            m[0] = HD(s, trellis.outputs[state][0], &puncturePattern[punctureIndex]);
-            m[1] = HD(s, trellis.outputs[state][1], &puncturePattern[punctureIndex]);
+            m[0] = HD(s, trellis.outputs[state][0], p);
+            m[1] = HD(s, trellis.outputs[state][1], p);
 
             fm[0] = prevMetric[state] + m[0];
             fm[1] = prevMetric[state+32] + m[1];
             uint32_t p1 = (fm[0] <= fm[1]) ? 0 : 1;
             currMetric[state*2] = fm[p1];
-            *d++ = state + 32 * p1;
 
             fm[0] = prevMetric[state] + m[1];
             fm[1] = prevMetric[state+32] + m[0];
             uint32_t p2 = (fm[0] <= fm[1]) ? 0 : 1;
             currMetric[state*2+1] = fm[p2];
-            *d++ = state + 32 * p2;
+
+            if(exchange) {
+                // Extend the selected survivor paths with the input into each state.
+                currSurvivor[state*2] = prevSurvivor[state + 32 * p1] << 1;
+                currSurvivor[state*2+1] = (prevSurvivor[state + 32 * p2] << 1) | 1;
+            } else {
+                *d++ = state + 32 * p1;
+                *d++ = state + 32 * p2;
+            }
+        }
+
+        // Advance and wrap trellis position.
+        if(!exchange) {
+            decisionPos++;
+            if(decisionPos >= (int)decisions.size()) {
+                decisionPos = 0;
+            }
         }
+        trellisTime++;
 
-        // Traceback, find the state with the current best path metric.
-        uint32_t bestFinalState = 0;
-        uint32_t bestHamming = currMetric[0];
+        // Swap path metric pointers
+        uint32_t *tmp = prevMetric;
+        prevMetric = currMetric;
+        currMetric = tmp;
+        std::swap(prevSurvivor, currSurvivor);
+
+        // Traceback from the best state, only want the input from
+        // tracebackDepth stages ago.
+        Emit(trellisTime - 1 - tracebackDepth, decoded, outCount);
+
+        // Advance input
+        s += N;
+        p += N;
+    }
+}
 
-        for(int i = 1; i < STATES; i++) {
-            if(currMetric[i] < bestHamming) {
-                bestHamming = currMetric[i];
-                bestFinalState = i;
+template<bool exchange>
+void ViterbiDecoder712H::DecodeRadix4(int first, int stages, BitVector &decoded, int &outCount)
+{
+    assert((stages % 2) == 0);
+
+    const uint8_t *s = &depunctured[first * N];
+    const uint8_t *p = &depuncturedMask[first * N];
+
+    // Go through each pair of trellis columns
+    for(int i = 0; i < stages; i += 2) {
+        uint8_t *d = exchange ? nullptr : &decisions[decisionPos][0];
+
+        // Precombine the branch metrics of both symbol pairs for all 16 two stage codes
+        uint32_t m1[4], m2[4], bm[16];
+        BranchMetrics(s, p, m1);
+        BranchMetrics(s + N, p + N, m2);
+        for(int c1 = 0; c1 < 4; c1++) {
+            for(int c2 = 0; c2 < 4; c2++) {
+                bm[c1*4 + c2] = m1[c1] + m2[c2];
             }
         }
 
-        // Trace back the best path, only want the input from the first
-        // step in the traceback.
-        int pathPos = decisionPos;
-        int cState = bestFinalState;
-        for(int i = 0; i < decisions.size() - 1; i++) {
-            cState = decisions[pathPos][cState];
+        // 4-way compare-select into each state.
+        // The 4 predecessors of a state share the low 4 bits (state >> 2).
+        for(uint32_t state = 0; state < STATES; state++) {
+            const uint8_t *c = radix4Codes[state];
+            const uint32_t *pm = &prevMetric[state >> 2];
+
+            uint32_t best = pm[0] + bm[c[0]];
+            uint8_t dec = 0;
+            for(int j = 1; j < 4; j++) {
+                uint32_t fm = pm[16*j] + bm[c[j]];
+                if(fm < best) {
+                    best = fm;
+                    dec = j;
+                }
+            }
 
-            pathPos--;
-            if(pathPos < 0) {
-                pathPos = decisions.size() - 1;
+            currMetric[state] = best;
+            if(exchange) {
+                // Both inputs of the two stage transition are the low bits of the state.
+                currSurvivor[state] = (prevSurvivor[(state >> 2) + 16 * dec] << 2) | (state & 3);
+            } else {
+                *d++ = dec;
             }
         }
 
-        // Append the first input to our traceback
-        decoded[i] = cState & 0x1;
+        if(!exchange) {
+            decisionPos++;
+            if(decisionPos >= (int)decisions.size()) {
+                decisionPos = 0;
+            }
+        }
+        trellisTime += 2;
 
-        // Advance and wrap trellis position.
-        decisionPos++;
-        if(decisionPos >= decisions.size()) {
-            decisionPos = 0;
+        uint32_t *tmp = prevMetric;
+        prevMetric = currMetric;
+        currMetric = tmp;
+        std::swap(prevSurvivor, currSurvivor);
+
+        // Normally emits the two inputs from tracebackDepth stages ago.
+        Emit(trellisTime - 1 - tracebackDepth, decoded, outCount);
+
+        s += 2*N;
+        p += 2*N;
+    }
+}
+
+// Metric of states that were not kept by reduced state decoding
+static const uint32_t InactiveMetric = std::numeric_limits<uint32_t>::max() / 2;
+// Largest metric distance from the best state told apart by reduced state selection.
+// The spread of the 7,1,2 state metrics is 12 at most.
+static const uint32_t ReducedMaxDistance = 15;
+
+// Index of the lowest set bit, v must not be zero.
+static int LowestBit(uint64_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(v);
+#else
+    int i = 0;
+    while(((v >> i) & 1) == 0) {
+        i++;
+    }
+    return i;
+#endif
+}
+
+// Number of set bits
+static int BitCount(uint64_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(v);
+#else
+    int count = 0;
+    for(; v != 0; v &= v - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+void ViterbiDecoder712H::DecodeReduced(int first, int stages, BitVector &decoded, int &outCount)
+{
+    const uint8_t *s = &depunctured[first * N];
+    const uint8_t *p = &depuncturedMask[first * N];
+
+    const uint32_t limit = (reducedThreshold > 0) ? std::min<uint32_t>(reducedThreshold, ReducedMaxDistance) :
+                                                    ReducedMaxDistance;
+
+    for(int i = 0; i < stages; i++) {
+        uint32_t bm[4];
+        BranchMetrics(s, p, bm);
+
+        // Only butterflies with a kept predecessor are computed. States that were
+        //   not kept read as the inactive metric, so the butterflies are the same
+        //   branchless ACS as full decoding, with the same tie breaking.
+        const uint64_t kept = activeStates;
+        uint32_t butterflies = (uint32_t)kept | (uint32_t)(kept >> 32);
+        uint64_t reached = 0;
+
+        // Best reached state, butterflies run in ascending state order so ties
+        //   go to the lowest state like BestState.
+        uint32_t bestState = 0;
+        uint32_t bestMetric = std::numeric_limits<uint32_t>::max();
+        while(butterflies != 0) {
+            uint32_t state = LowestBit(butterflies);
+            butterflies &= butterflies - 1;
+
+            uint32_t code = (ButterflyCodes712 >> (2 * state)) & 3;
+            uint32_t m0 = bm[code];
+            uint32_t m1 = bm[code ^ 3];
+            uint32_t pm0 = ((kept >> state) & 1) ? prevMetric[state] : InactiveMetric;
+            uint32_t pm1 = ((kept >> (state + 32)) & 1) ? prevMetric[state+32] : InactiveMetric;
+
+            uint32_t fm0 = pm0 + m0;
+            uint32_t fm1 = pm1 + m1;
+            uint32_t p1 = (fm0 <= fm1) ? 0 : 1;
+            uint32_t metric0 = p1 ? fm1 : fm0;
+            currMetric[state*2] = metric0;
+
+            fm0 = pm0 + m1;
+            fm1 = pm1 + m0;
+            uint32_t p2 = (fm0 <= fm1) ? 0 : 1;
+            uint32_t metric1 = p2 ? fm1 : fm0;
+            currMetric[state*2+1] = metric1;
+
+            currSurvivor[state*2] = prevSurvivor[state + 32 * p1] << 1;
+            currSurvivor[state*2+1] = (prevSurvivor[state + 32 * p2] << 1) | 1;
+
+            reached |= (uint64_t)3 << (2 * state);
+
+            uint32_t pairMetric = std::min(metric0, metric1);
+            uint32_t pairState = (metric1 < metric0) ? state*2 + 1 : state*2;
+            bool better = pairMetric < bestMetric;
+            bestMetric = better ? pairMetric : bestMetric;
+            bestState = better ? pairState : bestState;
         }
 
-        // Swap path metric pointers
+        // Keep states within the threshold, then the best reducedStates of those.
+        uint64_t within = 0;
+        for(uint64_t r = reached; r != 0; r &= r - 1) {
+            int next = LowestBit(r);
+            uint64_t inside = (currMetric[next] - bestMetric <= limit) ? 1 : 0;
+            within |= inside << next;
+        }
+
+        activeStates = within;
+        if(BitCount(within) > (int)reducedStates) {
+            // Metrics are small integers, count the states at each distance from the best.
+            int buckets[ReducedMaxDistance + 1] = {};
+            for(uint64_t r = within; r != 0; r &= r - 1) {
+                buckets[currMetric[LowestBit(r)] - bestMetric]++;
+            }
+
+            // Every state closer than the cutoff distance, then the lowest states at it.
+            uint32_t cutoff = 0;
+            int room = reducedStates;
+            while(buckets[cutoff] <= room) {
+                room -= buckets[cutoff++];
+            }
+            activeStates = 0;
+            for(uint64_t r = within; r != 0; r &= r - 1) {
+                int next = LowestBit(r);
+                uint32_t distance = currMetric[next] - bestMetric;
+                bool keep = (distance < cutoff) || (distance == cutoff && room > 0);
+                room -= (distance == cutoff && keep) ? 1 : 0;
+                activeStates |= (uint64_t)keep << next;
+            }
+        }
+        // Exactly the best reducedStates of the states within the threshold
+        assert(BitCount(activeStates) == std::min<int>(BitCount(within), reducedStates));
+
+        trellisTime++;
+
         uint32_t *tmp = prevMetric;
         prevMetric = currMetric;
         currMetric = tmp;
+        std::swap(prevSurvivor, currSurvivor);
+
+        Emit(trellisTime - 1 - tracebackDepth, bestState, decoded, outCount);
 
-        // Advance input
         s += N;
-        // Advance puncture pattern index
-        punctureIndex += 2;
-        if(punctureIndex >= puncturePattern.Size()) {
-            punctureIndex = 0;
+        p += N;
+    }
+
+    // Metrics outside the kept states are stale, BestState (Flush, link quality)
+    //   must only see the kept ones.
+    for(uint32_t state = 0; state < STATES; state++) {
+        prevMetric[state] = ((activeStates >> state) & 1) ? prevMetric[state] : InactiveMetric;
+    }
+}
+
+void ViterbiDecoder712H::Emit(int64_t last, BitVector &decoded, int &outCount)
+{
+    if(last < nextOutput) {
+        return;
+    }
+
+    // Latest metrics, the pointers were swapped after the last step.
+    Emit(last, BestState(prevMetric), decoded, outCount);
+}
+
+void ViterbiDecoder712H::Emit(int64_t last, uint32_t bestState, BitVector &decoded, int &outCount)
+{
+    if(last < nextOutput) {
+        return;
+    }
+
+    uint8_t *out = &decoded[outCount];
+
+    if(engine == SurvivorEngine712::RegisterExchange) {
+        // Bit b of the best survivor register is input trellisTime-1-b.
+        assert(trellisTime - 1 - nextOutput < 64);
+        uint64_t path = prevSurvivor[bestState];
+        for(int64_t pos = nextOutput; pos <= last; pos++) {
+            out[pos - nextOutput] = (path >> (trellisTime - 1 - pos)) & 0x1;
         }
+
+        outCount += last - nextOutput + 1;
+        nextOutput = last + 1;
+        return;
     }
 
-    assert(punctureIndex == 0);
+    // Every bit must still be covered by the decision history.
+    // Radix 4 columns hold two stages, divisions by the column length are shifts.
+    const int columnShift = radix / 4;
+    const int stagesPerColumn = radix / 2;
+    const int columns = decisions.size();
+    assert(trellisTime - nextOutput <= (int64_t)(columns - 1) * stagesPerColumn + 6);
+
+    // A state holds the previous 6 inputs of its path, bit b of the state at
+    //   time t is input t-1-b. The walk ends at the first state holding nextOutput.
+    const int64_t first = trellisTime - nextOutput - 6;
+    const int64_t bottom = trellisTime - (((first > 0) ? first + stagesPerColumn - 1 : 0) >> columnShift << columnShift);
+
+    // Latest decisions
+    uint32_t cState = bestState;
+    int pathPos = (decisionPos == 0) ? columns - 1 : decisionPos - 1;
+    const int topPos = pathPos;
+
+    // Walk back recording the path. Once it reaches a state the previous traceback
+    //   passed through at the same time, the older states are shared and already recorded.
+    for(int64_t t = trellisTime;; t -= stagesPerColumn) {
+        if(pathTimes[pathPos] == t && pathStates[pathPos] == cState) {
+            break;
+        }
+        pathTimes[pathPos] = t;
+        pathStates[pathPos] = cState;
+        if(t == bottom) {
+            break;
+        }
 
-    return decoded;
+        if(radix == 4) {
+            cState = (cState >> 2) | (decisions[pathPos][cState] << 4);
+        } else {
+            cState = decisions[pathPos][cState];
+        }
+        pathPos = (pathPos == 0) ? columns - 1 : pathPos - 1;
+    }
+
+    // Read the bits from the recorded path, newest first, each from the newest
+    //   state still holding it.
+    const int64_t newest = trellisTime - last - 6;
+    int64_t t = trellisTime;
+    int steps = (newest > 0) ? (int)((newest + stagesPerColumn - 1) >> columnShift) : 0;
+    t -= (int64_t)steps << columnShift;
+    pathPos = topPos - steps;
+    if(pathPos < 0) {
+        pathPos += columns;
+    }
+    for(int64_t pos = last; pos >= nextOutput; pos--) {
+        if(t - 6 > pos) {
+            t -= stagesPerColumn;
+            pathPos = (pathPos == 0) ? columns - 1 : pathPos - 1;
+        }
+        assert(pathTimes[pathPos] == t);
+        out[pos - nextOutput] = (pathStates[pathPos] >> (t - 1 - pos)) & 0x1;
+    }
+
+    outCount += last - nextOutput + 1;
+    nextOutput = last + 1;
 }
 
-BitVector ViterbiDecoder712H::DecodeTerminated(const BitVector &input)
+void ViterbiDecoder712H::UpdateLinkQuality(int channelBits, int stages)
 {
-    assert(input.Size() % puncturePattern.Ones() == 0);
-    uint32_t returnSize = ((input.Size() * puncturePattern.Size()) / puncturePattern.Ones()) / 2;
+    if(stages == 0) {
+        return;
+    }
 
-    // Reset trellis before and after a terminated decode
-    Reset();
+    // The best path metric never decreases, its growth is the errors corrected.
+    uint32_t bestMetric = prevMetric[BestState(prevMetric)];
+    uint32_t errors = bestMetric - linkLastMetric;
+    linkLastMetric = bestMetric;
 
-    BitVector decoded = Decode(input);
+    linkQuality.correctedErrors += errors;
+    linkQuality.channelBits += channelBits;
 
-    // Append enough zeros to satisfy the puncture pattern ratio and flush the full traceback.
-    int zerosToPad = ceil((double)(tracebackDepth * N) / puncturePattern.Ones())
-            * puncturePattern.Ones();
+    linkWindowErrors += errors;
+    linkWindowChannelBits += channelBits;
+    linkWindowStages += stages;
 
-    BitVector tail(zerosToPad);
-    tail.SetAll(0);
+    if(linkWindowChannelBits >= linkWindowBits) {
+        linkQuality.windowBer = (double)linkWindowErrors / linkWindowChannelBits;
+        linkQuality.metricSlope = (double)linkWindowErrors / linkWindowStages;
+        linkQuality.locked = linkQuality.windowBer < linkLockThreshold;
 
-    decoded += Decode(tail);
+        linkWindowErrors = 0;
+        linkWindowChannelBits = 0;
+        linkWindowStages = 0;
+    }
+}
 
-    // Reset trellis before and after a terminated decode
-    Reset();
+void ViterbiDecoder712H::SetLinkQualityWindow(uint32_t windowBits, double lockThreshold)
+{
+    assert(windowBits > 0);
+    linkWindowBits = windowBits;
+    linkLockThreshold = lockThreshold;
+    ResetLinkQuality();
+}
 
-    return decoded.Extract(tracebackDepth, returnSize);
+LinkQuality712 ViterbiDecoder712H::GetLinkQuality() const
+{
+    return linkQuality;
 }
 
-uint8_t ViterbiDecoder712H::HD(const uint8_t a[2], const uint8_t b[2], const uint8_t p[2])
+void ViterbiDecoder712H::ResetLinkQuality()
 {
-    return ((a[0] ^ b[0]) & p[0]) + ((a[1] ^ b[1]) & p[1]);
+    linkQuality.correctedErrors = 0;
+    linkQuality.channelBits = 0;
+    linkQuality.windowBer = 0.0;
+    linkQuality.metricSlope = 0.0;
+    linkQuality.locked = false;
+
+    linkWindowErrors = 0;
+    linkWindowChannelBits = 0;
+    linkWindowStages = 0;
 }
 
 void ViterbiDecoder712H::Reset()
 {
     // Need tracebackDepth+1 to ensure we have tracebackDepth previous states
-    int trellisDepth = tracebackDepth + 1;
+    // Radix 4 columns hold two stages each.
+    // Register exchange stores no decisions, one placeholder column is kept.
+    int trellisDepth = (radix == 4) ? (tracebackDepth / 2 + 1) : (tracebackDepth + 1);
+    if(engine == SurvivorEngine712::RegisterExchange) {
+        trellisDepth = 1;
+    }
     decisions.resize(trellisDepth);
 
     // Create each trellis column (states)
-    for(int i = 0; i < decisions.size(); i++) {
+    for(int i = 0; i < (int)decisions.size(); i++) {
         decisions[i].resize(STATES);
-        for(int j = 0; j < STATES; j++) {
+        for(uint32_t j = 0; j < STATES; j++) {
             decisions[i][j] = 0;
         }
     }
 
-    decisionPos = 1;
+    decisionPos = 1 % trellisDepth;
+    pathStates.assign(trellisDepth, 0);
+    pathTimes.assign(trellisDepth, NoPathTime);
+    trellisTime = 0;
+    nextOutput = -tracebackDepth;
+
+    schedule.clear();
+    lastPatternStage = 0;
+    depthChanges.clear();
+
+    punctureIx = 0;
+    heldCount = 0;
+    heldChannelBits = 0;
 
     // Reset path metric pointers
     prevMetric = hammingDistance[0];
     currMetric = hammingDistance[1];
 
+    prevSurvivor = survivorBits[0];
+    currSurvivor = survivorBits[1];
+
     // Initialize metrics to force zero starting state.
-    for(int i = 0; i < STATES; i++) {
+    for(uint32_t i = 0; i < STATES; i++) {
         prevMetric[i] = std::numeric_limits<uint32_t>::max() / 2;
         currMetric[i] = 0;
+        prevSurvivor[i] = 0;
+        currSurvivor[i] = 0;
     }
     // This forces the zero starting state.
     prevMetric[0] = 0;
-}
+    linkLastMetric = 0;
 
+    // Reduced state decoding starts from the zero state only.
+    activeStates = 1;
+}
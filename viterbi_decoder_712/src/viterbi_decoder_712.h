@@ -20,8 +20,37 @@
 
 #pragma once
 
+#include <deque>
+#include <utility>
+
 #include "bit_vector.h"
-#include "convolutional_encoder_712.h".h"
+#include "convolutional_encoder_712.h"
+
+// Running channel quality estimate derived from the decoder path metrics.
+// The best path metric is the number of channel bits that disagree with the
+//   decoded path, i.e. the channel errors corrected.
+struct LinkQuality712 {
+    // Channel bit errors corrected since the estimate was reset.
+    uint64_t correctedErrors;
+    // Channel (unpunctured) bits decoded since the estimate was reset.
+    uint64_t channelBits;
+    // Corrected errors per channel bit over the last completed window.
+    double windowBer;
+    // Best path metric growth per trellis stage over the last completed window.
+    double metricSlope;
+    // Set when the window BER is below the lock threshold.
+    bool locked;
+};
+
+// How the survivor paths are stored.
+enum class SurvivorEngine712 {
+    // Decisions are stored per stage and walked backward for every output.
+    Traceback,
+    // Each state keeps its survivor path in a 64 bit register, shifted and
+    //   selected during ACS. Output is read from the best state's register with
+    //   no traceback loop. Limited to traceback depths of at most 62.
+    RegisterExchange
+};
 
 // Hard decision Viterbi Decoder for the 7,1,2 [171, 133] polynomial.
 // Puncture pattern and traceback depth can be configured.
@@ -29,6 +58,7 @@
 // Continuous decoding will return 'TracebackDepth' 0 bits after a reset.
 // Continuous decoding assumes start state is zero.
 // Terminated decoding assuming first and last state is zero.
+// Can process one (radix 2) or two (radix 4) trellis stages per ACS step.
 class ViterbiDecoder712H {
     // Output rate
     static const uint32_t N = 2;
@@ -46,13 +76,78 @@ public:
     void SetPuncturePattern(const BitVector &pattern);
     BitVector GetPuncturePattern() const;
 
+    // Reduced state (M-algorithm) decoding. After each stage only the best
+    //   maxStates states, and of those only the ones within threshold of the best
+    //   metric, are kept and extended. Trades BER for fewer add-compare-select steps.
+    // Pays off when few states are kept. A threshold alone adapts to the channel,
+    //   at rate 1/2 a threshold of 3 keeps about 10 states with no BER loss on
+    //   a fair channel. Punctured patterns keep many more states at the same threshold.
+    //   Selecting the best maxStates costs about what it saves with 64 states, so
+    //   maxStates bounds the work per stage rather than reducing it.
+    //   Run the example with 'benchmark' to compare.
+    // maxStates of 64 with a threshold of 0 (no threshold) is full Viterbi decoding.
+    // Thresholds above 15 keep every state.
+    // Requires radix 2 and the register exchange engine. Resets the decoder state.
+    void SetReducedState(uint32_t maxStates, uint32_t threshold);
+    uint32_t GetReducedStateCount() const;
+    uint32_t GetReducedStateThreshold() const;
+
+    // Selects the survivor path storage, see SurvivorEngine712.
+    // Setting a new engine resets the decoder state.
+    void SetSurvivorEngine(SurvivorEngine712 newEngine);
+    SurvivorEngine712 GetSurvivorEngine() const;
+
+    // Schedules a new puncture pattern, and traceback depth when depth > 0, to take
+    //   effect at trellis stage 'stage' (decoded bit position since the last reset).
+    // Path metrics and decision history are kept, the decoder is not reset.
+    // The stage must fall on a puncture period boundary of the pattern used before it,
+    //   and switches must be scheduled in stage order.
+    // Input spanning a switch must complete the period of each pattern it covers.
+    // Scheduled switches are cleared on reset.
+    void SchedulePuncturePattern(const BitVector &pattern, uint32_t depth, int64_t stage);
+    // Trellis stages received since the last reset, including stages DecodeStream
+    //   holds, a partly received one counted. The earliest stage a switch can be scheduled at.
+    int64_t GetStage() const;
+
+    // Radix 2 advances one trellis stage per add-compare-select step.
+    // Radix 4 advances two stages per step using a 4-way compare-select
+    //   into each state, halving the metric and decision traffic.
+    // Radix 4 requires an even number of trellis stages per Decode call.
+    // Radix 4 breaks metric ties among its 4 paths differently than two radix 2
+    //   steps, so output may differ from radix 2 on noisy input (with the same BER).
+    //   Guarantees of identical output elsewhere compare like radices.
+    // Setting a new radix resets the decoder state.
+    void SetRadix(uint32_t newRadix);
+    uint32_t GetRadix() const;
+
     // Input is encoded and punctured bit vector.
     // Depunctured input length must be multiple of the puncture pattern length.
     // Treat input as continous stream using previous state.
     // Uses last state as start of decode unless Reset is called.
     // Same functionality as 'Continuous' TerminationMethod in MATLAB.
+    // Returns one bit per trellis stage unless bits were already returned
+    //   early by Flush or DecodeWithLatency, those are not returned again.
     BitVector Decode(const BitVector &input);
 
+    // Same as Decode, but after the input is processed every bit older than
+    //   'latency' stages is returned, traced back from the current best state.
+    // A latency above the traceback depth is limited to the traceback depth.
+    // Bits returned with a reduced latency have seen less of the trellis
+    //   and are not revised by later calls.
+    BitVector DecodeWithLatency(const BitVector &input, uint32_t latency);
+
+    // Same as Decode, but input may be any length. A partial puncture period, or
+    //   with radix 4 an odd trailing stage, is held and decoded with the next call
+    //   as if the buffers had arrived as one. Decode and DecodeWithLatency require
+    //   the stream to end on a period (and radix 4 step) boundary.
+    BitVector DecodeStream(const BitVector &input);
+
+    // Returns all pending bits (the last 'TracebackDepth' inputs) using a traceback
+    //   from the current best state. Trellis state is kept and decoding continues
+    //   with the next call as if the stream was never interrupted.
+    // Input held by DecodeStream is not decoded and stays held.
+    BitVector Flush();
+
     // Input is encoded and punctured bit vector.
     // Depunctured input length must be multiple of the puncture pattern length.
     // Treat input independently.
@@ -63,27 +158,127 @@ public:
     BitVector DecodeTerminated(const BitVector &input);
 
     // Resets decision history and restarts decoder.
+    // The link quality estimate is not reset.
     void Reset();
 
+    // Link quality is updated at the end of every decode call from the best path metric.
+    // A window completes once at least windowBits channel bits have been decoded.
+    // The link is reported locked while the window BER is below lockThreshold.
+    // Random (unlocked) input reads about 0.12 at rate 1/2 down to 0.03 at rate 5/6,
+    //   so the threshold should be chosen for the puncture pattern. Default 0.02.
+    // Resets the link quality estimate.
+    void SetLinkQualityWindow(uint32_t windowBits, double lockThreshold);
+    LinkQuality712 GetLinkQuality() const;
+    void ResetLinkQuality();
+
 private:
     // Hamming distance between a and b (2 bits) ignoring the bits
     // if the associated bit in p is set to zero.
     uint8_t HD(const uint8_t a[2], const uint8_t b[2], const uint8_t p[2]);
 
+    // Decode, DecodeWithLatency, DecodeStream, Flush and DecodeTerminated.
+    // tailBits zeros follow the input, they are decoded but not counted as received.
+    // Without stream the input must end on a period (and radix 4 step) boundary.
+    BitVector DecodeInput(const BitVector &input, int tailBits, uint32_t latency, bool stream);
+    // Fills the depunctured and depuncturedMask arrays from the held bits, input
+    //   and tailBits zeros, switching patterns as scheduled. Returns the number of trellis stages
+    //   ready to decode, any remaining bits are held for the next call.
+    int Depuncture(const BitVector &input, int tailBits, bool stream);
+    // Grows the decision history, keeping its contents, to cover depth.
+    void ReserveDepth(int depth);
+    // Path metrics for the four output codes of a single trellis stage.
+    void BranchMetrics(const uint8_t *s, const uint8_t *p, uint32_t m[4]);
+    // Find the state with the best path metric.
+    uint32_t BestState(const uint32_t *metric) const;
+
+    // Processes the depunctured stages [first, first+stages), emitting bits older
+    //   than tracebackDepth.
+    // Output is written to decoded starting at outCount, outCount is advanced.
+    void DecodeStages(int first, int stages, BitVector &decoded, int &outCount);
+    template<bool exchange>
+    void DecodeRadix2(int first, int stages, BitVector &decoded, int &outCount);
+    template<bool exchange>
+    void DecodeRadix4(int first, int stages, BitVector &decoded, int &outCount);
+    void DecodeReduced(int first, int stages, BitVector &decoded, int &outCount);
+    // Emits the inputs [nextOutput, last] from a traceback of the current best state.
+    void Emit(int64_t last, BitVector &decoded, int &outCount);
+    void Emit(int64_t last, uint32_t bestState, BitVector &decoded, int &outCount);
+    // Accumulates the best path metric growth since the last update.
+    void UpdateLinkQuality(int channelBits, int stages);
+
     Trellis712 trellis;
+    // Two stage output codes into each state from each of its 4 predecessors.
+    // Predecessor d of state s is (s >> 2) | (d << 4).
+    // Code is (first stage output << 2) | second stage output.
+    uint8_t radix4Codes[64][4];
+    // Stages per ACS step, 2 or 4
+    uint32_t radix;
+    SurvivorEngine712 engine;
+    // Reduced state limits, full decoding when not reduced
+    uint32_t reducedStates, reducedThreshold;
+    // States extended by the next reduced state step, bit s for state s
+    uint64_t activeStates;
     // User supplied puncture pattern
     BitVector puncturePattern;
     // User specified
     int tracebackDepth;
-    // The decision matric.
+    // A pattern switch scheduled for a trellis stage, depth 0 keeps the depth.
+    struct ScheduledPattern {
+        int64_t stage;
+        BitVector pattern;
+        int depth;
+    };
+    // Pending switches in stage order
+    std::deque<ScheduledPattern> schedule;
+    // Stage at which the last scheduled (or current) pattern starts
+    int64_t lastPatternStage;
+    // Traceback depth changes within the current call as (stage in call, depth)
+    // Changes inside held stages are carried to the next call.
+    std::vector<std::pair<int, int>> depthChanges;
+    // Index into the puncture pattern of the next input bit, only nonzero while
+    //   DecodeStream holds a partial period.
+    int punctureIx;
+    // Depunctured bits and flags not yet decoded, at most one radix 4 step.
+    uint8_t heldBits[2 * N], heldMask[2 * N];
+    int heldCount;
+    // Received (unpunctured) bits among the held bits
+    int heldChannelBits;
+    // Depunctured input and the puncture flag for each depunctured bit.
+    // Punctured bits have a flag of zero and are ignored in the path metrics.
+    BitVector depunctured, depuncturedMask;
+    // The decision matric. Not used by the register exchange engine.
     // Allocated up front to match the traceback depth.
-    // TracebackDepth * 64 values. Each value is the previous state into that state.
+    // Radix 2: TracebackDepth * 64 values. Each value is the previous state into that state.
+    // Radix 4: TracebackDepth/2 * 64 values. Each value is the 2-bit predecessor index.
     std::vector<std::vector<uint8_t>> decisions;
     // Tracks our current position in the decision table
     int decisionPos;
+    // The path of the last traceback, per decision column the state at the end of
+    //   that column's stage and its trellis time. A traceback stops where it joins it.
+    std::vector<uint8_t> pathStates;
+    std::vector<int64_t> pathTimes;
+    // Trellis stages processed since reset
+    int64_t trellisTime;
+    // Index of the next input to return. Starts at -tracebackDepth after a reset,
+    //   negative positions are the leading zeros of continuous decoding.
+    int64_t nextOutput;
 
     // Stored Hamming distance and previous state hamming distance
     uint32_t hammingDistance[2][64];
     // Pointers to the two hamming distance arrays. Swapped on each bit decision.
     uint32_t *prevMetric, *currMetric;
+
+    // Register exchange survivor paths, bit 0 is the newest input.
+    uint64_t survivorBits[2][64];
+    // Swapped alongside the metric pointers.
+    uint64_t *prevSurvivor, *currSurvivor;
+
+    // Link quality estimate
+    LinkQuality712 linkQuality;
+    uint32_t linkWindowBits;
+    double linkLockThreshold;
+    // Best path metric at the last update, zero after a reset
+    uint32_t linkLastMetric;
+    // Accumulation of the current window
+    uint64_t linkWindowErrors, linkWindowChannelBits, linkWindowStages;
 };
@@ -4,10 +4,20 @@ CONFIG -= app_bundle
 CONFIG -= qt
 
 SOURCES += main.cpp \
+    src/bitsliced_viterbi_decoder_712.cpp \
+    src/concatenated_decoder_712.cpp \
     src/convolutional_encoder_712.cpp \
+    src/reed_solomon_255_223.cpp \
+    src/sample_demapper_712.cpp \
+    src/viterbi_channel_bank_712.cpp \
     src/viterbi_decoder_712.cpp
 
 HEADERS += \
     src/bit_vector.h \
+    src/bitsliced_viterbi_decoder_712.h \
+    src/concatenated_decoder_712.h \
     src/convolutional_encoder_712.h \
+    src/reed_solomon_255_223.h \
+    src/sample_demapper_712.h \
+    src/viterbi_channel_bank_712.h \
     src/viterbi_decoder_712.h
@@ -0,0 +1,17 @@
+TEMPLATE = app
+CONFIG += console c++11
+CONFIG -= app_bundle
+CONFIG -= qt
+
+LIBS += -lpthread -lrt
+
+SOURCES += decode_service_main.cpp \
+    src/convolutional_encoder_712.cpp \
+    src/decode_service_712.cpp \
+    src/viterbi_decoder_712.cpp
+
+HEADERS += \
+    src/bit_vector.h \
+    src/convolutional_encoder_712.h \
+    src/decode_service_712.h \
+    src/viterbi_decoder_712.h